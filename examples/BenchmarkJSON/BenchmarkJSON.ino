@@ -0,0 +1,293 @@
+/*
+ * BenchmarkJSON.ino
+ * Benchmark suite for the library's audio kernels and control paths, printed as one JSON object
+ * so results can be saved and compared between versions. No CODEC board is required.
+ *
+ * kernels: DWT cycles per audio block (best of RUNS) for the TDM pack/unpack kernels (memcpy_tdm.h),
+ *   with metering and gain, and the TDM_32 float scaling when the OpenAudio F32 library is installed.
+ *   The matrix mixer kernels (mixer_kernels.h) for a 16x16 mix, dense and sparse, steady and ramping:
+ *   there channels is the number of crosspoints, so cycles_per_sample is per crosspoint.
+ * designers: DWT cycles per call (best of RUNS) for each DAC biquad design, without the I2C writes.
+ * control: enable(), DAC filter, ADC filter and AGC sequences replayed on a simulated I2C bus
+ *   (simulateI2C()) for 8 CODECs, with the I2C transactions and bytes they cost.
+ *   bus_us is the time those bytes take at the I2C clock; us is the CPU time of the call,
+ *   including any settling delays in the sequence.
+ *
+ * Capture the Serial output (one line starting with '{') and diff it against a previous run.
+ */
+
+#include <Audio.h>
+#include <Wire.h>
+#include "memcpy_tdm.h"
+#include "mixer_kernels.h"
+#include "control_tlv320aic3104.h"
+#if defined(__has_include) && __has_include(<AudioStream_F32.h>)
+#include "output_tdm32.h"
+#endif
+
+#define RUNS 50
+#define CODECS 8
+#define I2C_CLOCK 400000
+
+#define TDM_A_WORDS 8 // one data line: 16 x 16-bit slots
+#define TDM_B_WORDS 16 // 16 x 32-bit slots
+#define TDM_32_WORDS 8 // 8 x 32-bit slots
+
+DMAMEM __attribute__((aligned(32))) uint32_t dma_buffer[AUDIO_BLOCK_SAMPLES * 16];
+int16_t blocks[16][AUDIO_BLOCK_SAMPLES];
+uint32_t zeros[AUDIO_BLOCK_SAMPLES/2];
+float32_t float_blocks[8][AUDIO_BLOCK_SAMPLES];
+int32_t int_blocks[8][AUDIO_BLOCK_SAMPLES];
+int16_t mix_out[16][AUDIO_BLOCK_SAMPLES];
+int mix_routes = 16; // inputs per output
+int32_t mix_change = 0; // gain change across the block: 0 = steady
+int coef[5];
+tdm_meter_acc meter[16];
+tdm_gain gain[16];
+uint32_t seed = 0x12345678;
+uint16_t live = 0xFFFF; // tx: channels with a block
+bool first = true;
+
+AudioControlTLV320AIC3104 aic(CODECS, true, AICMODE_TDM);
+
+/******************************** kernels ********************************/
+// Gains ramping all the time: the worst case for the gain kernels
+static void rampGains(int steps)
+{
+  for (int i = 0; i < 16; i++)
+    tdm_gain_begin(gain[i], (gain[i].ramp_to == TDM_GAIN_UNITY) ? TDM_GAIN_UNITY / 2 : TDM_GAIN_UNITY, steps);
+}
+
+static void tdmA_rx16(void)
+{
+  for (int i = 0; i < 16; i += 2)
+    memcpy_tdm_rx_16<TDM_A_WORDS>(blocks[i], blocks[i+1], dma_buffer + i/2);
+}
+
+static void tdmA_rx16_meter(void)
+{
+  for (int i = 0; i < 16; i += 2)
+    memcpy_tdm_rx_16<TDM_A_WORDS, true>(blocks[i], blocks[i+1], dma_buffer + i/2, AUDIO_BLOCK_SAMPLES, &meter[i]);
+}
+
+static void tdmA_rx16_gain(void)
+{
+  rampGains(AUDIO_BLOCK_SAMPLES / 2);
+  for (int i = 0; i < 16; i += 2)
+    memcpy_tdm_rx_16<TDM_A_WORDS, false, true>(blocks[i], blocks[i+1], dma_buffer + i/2, AUDIO_BLOCK_SAMPLES, nullptr, &gain[i]);
+}
+
+// as the output engine: pairs with no live channel are zeroed once, then left alone
+static void tdmA_tx(void)
+{
+  static uint8_t silent = 0;
+  for (int i = 0; i < 16; i += 2) {
+    uint8_t pair = 1 << (i >> 1);
+    const uint32_t *src1 = (live & (1 << i)) ? (uint32_t *)blocks[i] : zeros;
+    const uint32_t *src2 = (live & (2 << i)) ? (uint32_t *)blocks[i+1] : zeros;
+    if (src1 != zeros || src2 != zeros) {
+      memcpy_tdm_tx<TDM_A_WORDS>(dma_buffer + i/2, src1, src2);
+      silent &= ~pair;
+    } else if (!(silent & pair)) {
+      memset_tdm_tx<TDM_A_WORDS>(dma_buffer + i/2);
+      silent |= pair;
+    }
+  }
+}
+
+static void tdmA_tx_gain(void)
+{
+  rampGains(AUDIO_BLOCK_SAMPLES / 2);
+  for (int i = 0; i < 16; i += 2)
+    memcpy_tdm_tx<TDM_A_WORDS, true>(dma_buffer + i/2, (uint32_t *)blocks[i], (uint32_t *)blocks[i+1], AUDIO_BLOCK_SAMPLES, &gain[i]);
+}
+
+static void tdmB_rx(void)
+{
+  for (int i = 0; i < 16; i++)
+    memcpy_tdm_rx_16_even<TDM_B_WORDS>(blocks[i], dma_buffer + i);
+}
+
+static void tdmB_tx(void)
+{
+  for (int i = 0; i < 16; i++)
+    memcpy_tdm_tx_32<TDM_B_WORDS>(dma_buffer + i, (uint32_t *)blocks[i]);
+}
+
+// TDM_A with 24-bit words: 8 x 32-bit slots reduced to int16 with TPDF dither
+static void tdmA24_rx_dither(void)
+{
+  for (int i = 0; i < 8; i++)
+    memcpy_tdm_rx_32to16<TDM_32_WORDS>(blocks[i], dma_buffer + i, seed, true, 0xFFFFFF00);
+}
+
+#if defined(F32_TO_I32_NORM_FACTOR)
+static void tdm32_scale(void)
+{
+  for (int i = 0; i < 8; i++)
+    AudioOutputTDM_32::scale_f32_to_i32(float_blocks[i], int_blocks[i], AUDIO_BLOCK_SAMPLES);
+}
+
+static void tdm32_scale_gain(void)
+{
+  rampGains(AUDIO_BLOCK_SAMPLES);
+  for (int i = 0; i < 8; i++)
+    AudioOutputTDM_32::scale_f32_to_i32(float_blocks[i], int_blocks[i], AUDIO_BLOCK_SAMPLES, &gain[i]);
+}
+#endif
+
+// 16x16 matrix mixer as AudioMixerMatrix::update() runs it: each output takes mix_routes inputs,
+// the first with applyGain(), the rest added. Gain 0.5, as unity takes the copy and add paths.
+static void mix16(void)
+{
+  for (int o = 0; o < 16; o++) {
+    applyGain(mix_out[o], blocks[o], MULTI_UNITYGAIN / 2, mix_change);
+    for (int r = 1; r < mix_routes; r++)
+      applyGainThenAdd(mix_out[o], blocks[(o + r) & 15], MULTI_UNITYGAIN / 2, mix_change);
+  }
+}
+
+// channels: those doing work, for the per sample figure
+void kernel(const char *name, int channels, void (*fn)(void))
+{
+  uint32_t start, cycles = 0xFFFFFFFF;
+
+  for (int run = 0; run < RUNS; run++) {
+    start = ARM_DWT_CYCCNT;
+    fn();
+    cycles = min(cycles, ARM_DWT_CYCCNT - start);
+  }
+  float cpu = 100.0f * cycles * (AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES) / F_CPU_ACTUAL;
+  Serial.printf("%s\n    {\"name\":\"%s\",\"channels\":%i,\"cycles\":%lu,\"cycles_per_sample\":%.2f,\"cpu_pct\":%.4f}",
+    first ? "" : ",", name, channels, cycles, (float)cycles / (channels * AUDIO_BLOCK_SAMPLES), cpu);
+  first = false;
+}
+
+/******************************* designers *******************************/
+void designer(const char *name, void (*fn)(void))
+{
+  uint32_t start, cycles = 0xFFFFFFFF;
+
+  for (int run = 0; run < RUNS; run++) {
+    start = ARM_DWT_CYCCNT;
+    fn();
+    cycles = min(cycles, ARM_DWT_CYCCNT - start);
+  }
+  Serial.printf("%s\n    {\"name\":\"%s\",\"cycles\":%lu,\"us\":%.2f}",
+    first ? "" : ",", name, cycles, cycles * 1e6f / F_CPU_ACTUAL);
+  first = false;
+}
+
+void designHighpass(void)  { aic.designFilter(AIC_HIGHPASS, 80, 0.7071, 0, coef); }
+void designLowpass(void)   { aic.designFilter(AIC_LOWPASS, 8000, 0.7071, 0, coef); }
+void designBandpass(void)  { aic.designFilter(AIC_BANDPASS, 1000, 1.0, 0, coef); }
+void designNotch(void)     { aic.designFilter(AIC_NOTCH, 2000, 2, 0, coef); }
+void designLowShelf(void)  { aic.designFilter(AIC_LOWSHELF, 200, 1.0f, 6, coef); }
+void designHighShelf(void) { aic.designFilter(AIC_HIGHSHELF, 6000, 1.0f, -6, coef); }
+
+/******************************** control ********************************/
+void control(const char *name, void (*fn)(void))
+{
+  aic_i2c_stats s;
+  uint32_t us;
+
+  aic.resetI2CStats();
+  us = micros();
+  fn();
+  us = micros() - us;
+  aic.getI2CStats(s);
+  Serial.printf("%s\n    {\"name\":\"%s\",\"codecs\":%i,\"us\":%lu,\"writes\":%lu,\"reads\":%lu,\"mux_writes\":%lu,\"probes\":%lu,\"bytes\":%lu,\"bus_us\":%lu}",
+    first ? "" : ",", name, CODECS, us, s.writes, s.reads, s.mux_writes, s.probes, s.bytes,
+    (uint32_t)((uint64_t)s.bytes * 9 * 1000000 / I2C_CLOCK)); // 8 bits + ACK per byte
+  first = false;
+}
+
+void seqBegin(void)   { aic.begin(); }
+void seqEnable(void)  { aic.enable(); }
+void seqVolume(void)  { aic.volume(0.8, CH_BOTH, AIC_ALL_CODECS); aic.inputLevel(-6, CH_BOTH, AIC_ALL_CODECS); }
+void seqDACfilters(void)
+{
+  aic.setHighpass(0, 80, 0.7071, CH_BOTH, AIC_ALL_CODECS);
+  aic.setNotch(1, 2000, 2, CH_BOTH, AIC_ALL_CODECS);
+}
+void seqShelves(void)
+{
+  aic.setLowShelf(0, 200, 6, 1.0f, CH_BOTH, AIC_ALL_CODECS);
+  aic.setHighShelf(1, 6000, -6, 1.0f, CH_BOTH, AIC_ALL_CODECS);
+}
+void seqADCfilter(void) { aic.adcHPF(100, CH_BOTH, AIC_ALL_CODECS); }
+void seqAGC(void)
+{
+  aic.AGC(AGCT10, AGCA8, AGCD400, 0, AGCH1, -30, false, CH_BOTH, AIC_ALL_CODECS);
+  aic.AGCenable(true, CH_BOTH, AIC_ALL_CODECS);
+}
+
+/********************************* main **********************************/
+void setup()
+{
+  Serial.begin(115200);
+  while (!Serial && millis() < 3000) ;
+
+  randomSeed(1);
+  for (unsigned i = 0; i < sizeof(dma_buffer) / 4; i++)
+    dma_buffer[i] = random();
+  for (int i = 0; i < 16; i++)
+    for (int j = 0; j < AUDIO_BLOCK_SAMPLES; j++)
+      blocks[i][j] = random(-32768, 32767);
+  for (int i = 0; i < 8; i++)
+    for (int j = 0; j < AUDIO_BLOCK_SAMPLES; j++)
+      float_blocks[i][j] = random(-10000, 10000) / 10000.0f;
+
+  Serial.printf("{\"suite\":\"TLV320AIC3104\",\"f_cpu\":%lu,\"fs\":%.0f,\"block\":%i,\"runs\":%i,\n  \"kernels\":[",
+    F_CPU_ACTUAL, AUDIO_SAMPLE_RATE_EXACT, AUDIO_BLOCK_SAMPLES, RUNS);
+  kernel("tdm_a_rx_16", 16, tdmA_rx16);
+  kernel("tdm_a_rx_16_meter", 16, tdmA_rx16_meter);
+  kernel("tdm_a_rx_16_gain_ramp", 16, tdmA_rx16_gain);
+  live = 0xFFFF;
+  kernel("tdm_a_tx_dense", 16, tdmA_tx);
+  live = 0x0023; // 3 live outputs
+  kernel("tdm_a_tx_sparse", 3, tdmA_tx);
+  kernel("tdm_a_tx_gain_ramp", 16, tdmA_tx_gain);
+  kernel("tdm_b_rx", 16, tdmB_rx);
+  kernel("tdm_b_tx", 16, tdmB_tx);
+  kernel("tdm_a24_rx_dither", 8, tdmA24_rx_dither);
+#if defined(F32_TO_I32_NORM_FACTOR)
+  kernel("tdm_32_f32_to_i32", 8, tdm32_scale);
+  kernel("tdm_32_f32_to_i32_gain_ramp", 8, tdm32_scale_gain);
+#endif
+  mix_routes = 16;
+  mix_change = 0;
+  kernel("mixer_dense", 256, mix16);
+  mix_change = RAMP_CHANGE(MULTI_UNITYGAIN / 4);
+  kernel("mixer_dense_ramp", 256, mix16);
+  mix_routes = 2; // the diagonal and one more
+  mix_change = 0;
+  kernel("mixer_sparse", 32, mix16);
+  mix_change = RAMP_CHANGE(MULTI_UNITYGAIN / 4);
+  kernel("mixer_sparse_ramp", 32, mix16);
+
+  Serial.print("\n  ],\n  \"designers\":[");
+  first = true;
+  designer("highpass", designHighpass);
+  designer("lowpass", designLowpass);
+  designer("bandpass", designBandpass);
+  designer("notch", designNotch);
+  designer("low_shelf", designLowShelf);
+  designer("high_shelf", designHighShelf);
+
+  Serial.print("\n  ],\n  \"control\":[");
+  first = true;
+  aic.simulateI2C(true);
+  control("begin", seqBegin);
+  control("enable", seqEnable);
+  control("volume_level", seqVolume);
+  control("dac_filters", seqDACfilters);
+  control("dac_shelves", seqShelves);
+  control("adc_hpf", seqADCfilter);
+  control("agc", seqAGC);
+  Serial.println("\n  ]\n}");
+}
+
+void loop()
+{
+}
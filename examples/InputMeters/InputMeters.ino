@@ -0,0 +1,62 @@
+/*
+ * InputMeters.ino
+ * TLV320AIC3104 multi board
+ * Peak, RMS and clip metering of every TDM input, fused into the input driver.
+ * No AudioAnalyzePeak/RMS objects, connections or audio blocks are needed for the meters.
+ * Uses TDMA Revised library
+ */
+
+#include "output_tdmA.h"
+#include "input_tdmA.h"
+#include <Audio.h>
+#include <Wire.h>
+#include "control_tlv320aic3104.h"
+
+#define CODECS        8
+#define AUDIO_BLOCKS  8
+#define METERS        (CODECS * 2)
+
+AudioInputTDM_A          tdm_in;
+AudioOutputTDM_A         tdm_out;
+AudioConnection          patchCord1(tdm_in, 0, tdm_out, 0); // channel 0 is monitored on output 0
+
+AudioControlTLV320AIC3104 aic(CODECS, true, AICMODE_TDM);
+
+tdm_meter_t levels[METERS];
+
+void setup() 
+{
+  AudioMemory(AUDIO_BLOCKS);
+  Serial.begin(115200);
+  delay(2000);
+  Serial.println("\n\nT4 TDM AIC3104 example - fused input metering");
+
+  Wire.begin();
+  Wire.setClock(400000);
+
+  aic.begin();
+  aic.inputMode(AIC_SINGLE);
+  if(!aic.enable()) 
+    Serial.println("Failed to initialise codec");
+  aic.volume(1, CH_BOTH, AIC_ALL_CODECS);
+  aic.inputLevel(0, CH_BOTH, AIC_ALL_CODECS);
+
+  tdm_in.setMeterBallistics(1500, 300); // peak release, RMS integration (mS)
+  tdm_in.setMetering(true);
+}
+
+void loop() 
+{
+  static uint32_t lastTime = 0;
+  if (millis() - lastTime > 1000)
+  {
+    lastTime = millis();
+    tdm_in.getMeters(levels, METERS);
+    for (int i = 0; i < METERS; i++)
+    {
+      Serial.printf("%2i: peak %6.1f dB, RMS %6.1f dB, clips %lu\n", i,
+        20 * log10f(levels[i].peak + 1e-6f), 10 * log10f(levels[i].power + 1e-12f), levels[i].clips);
+    }
+    Serial.printf("audioProc %2.1f%%, audioMem %i\n\n", AudioProcessorUsage(), AudioMemoryUsage()); 
+  }
+}
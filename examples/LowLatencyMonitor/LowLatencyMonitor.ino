@@ -0,0 +1,80 @@
+/*
+ * TLV320AIC3104 TDM board multi-codec
+ * Low latency monitoring
+ * Inputs 0 and 1 are mixed into outputs 0 and 1 in the transmit ISR callback, every DMA period
+ * Input 2 goes to output 2 through the audio graph for comparison
+ * Set TDM_A_DMA_FRAMES in output_tdmA.h to 16 or 32 for the lowest latency
+ * Uses TDMA Revised library
+ */
+
+#include "output_tdmA.h"
+#include "input_tdmA.h"
+#include "memcpy_tdm.h"
+#include <Audio.h>
+#include <Wire.h>
+#include "control_tlv320aic3104.h"
+
+#define CODECS 2
+#define AUDIO_BLOCKS 16
+#define MONITOR_GAIN 0.7f
+
+AudioInputTDM_A          tdm_in;   // declared first, so the input ISR runs the audio graph
+AudioOutputTDM_A         tdm_out;
+
+AudioConnection          patchCord1(tdm_in, 2, tdm_out, 2);
+
+AudioControlTLV320AIC3104 aic(CODECS, true, AICMODE_TDM);
+
+volatile int32_t monitorGain = MONITOR_GAIN * 32768;
+
+// Runs in the transmit ISR: keep it short.
+// rx is the latest received sub-block, tx already holds the audio graph output.
+void monitor(const uint32_t *rx, uint32_t *tx, int frames)
+{
+  if (rx == nullptr)
+    return;
+  for (int f = 0; f < frames; f++)
+  {
+    for (int slot = 0; slot < 2; slot++)
+    {
+      int32_t s = tdm_a_get(tx, f, slot, TDM_A_TX_LINES) + ((tdm_a_get(rx, f, slot, TDM_A_RX_LINES) * monitorGain) >> 15);
+      tdm_a_put(tx, f, slot, constrain(s, -32768, 32767), TDM_A_TX_LINES);
+    }
+  }
+}
+
+void setup() 
+{
+  AudioMemory(AUDIO_BLOCKS);
+  Serial.begin(115200);
+  delay(1000); 
+  Serial.println("\n\nT4 TDM AIC3104 example - low latency monitoring");
+  Serial.printf("DMA period %i frames, %3.2f mS\n", TDM_A_DMA_FRAMES, TDM_A_DMA_FRAMES * 1000.0 / AUDIO_SAMPLE_RATE_EXACT);
+
+  Wire.begin();
+  Wire.setClock(400000);
+  if (!aic.begin())
+    Serial.println("No muxes found");
+  aic.inputMode(AIC_SINGLE);
+  if(!aic.enable(AIC_ALL_CODECS))
+    Serial.println("Failed to initialise codec");
+  aic.volume(1, CH_BOTH, AIC_ALL_CODECS);
+  aic.inputLevel(0, CH_BOTH, AIC_ALL_CODECS);
+
+  tdm_out.setCallback(monitor);
+}
+
+void loop() 
+{
+  static uint32_t lastTime = 0;
+  if (millis() - lastTime > 2000)
+  {
+    AudioOutputTDM_A::stats_t tx;
+    AudioInputTDM_A::stats_t rx;
+    tdm_out.getStats(tx);
+    tdm_in.getStats(rx);
+    Serial.printf("CPU %3.2f%%, transmit ISR %lu cycles (mean %lu, max %lu), missed deadlines: in %lu, out %lu, allocation failures %lu\n",
+      AudioProcessorUsage(), tx.cycles_last, tx.cycles_mean, tx.cycles_max, rx.missed, tx.missed, rx.alloc_fails);
+    lastTime = millis();
+  }
+}
@@ -89,6 +89,7 @@ void setup()
 
   sine[1].frequency(1200);
   sine[1].amplitude(0.8);
+  mixer.setRamp(16, MM_RAMP_EXP); // ~50 mS crossfades when the sines swap
   mixer.gain(0, 0, 1.0); // mix: first two input channels to corresponding output channels and peaks
   mixer.gain(1, 1, 1.0);
 
@@ -29,110 +29,109 @@
 
 #include <Arduino.h>
 #include "mixerMatrix.h"
-#include "utility/dspinst.h"
+#include "mixer_kernels.h"
 
-#if defined(__ARM_ARCH_7EM__)
-#define MULTI_UNITYGAIN 65536
-
-static void applyGain(int16_t *data, int32_t mult)
+void AudioMixerMatrix::setRamp(int blocks, int shape)
 {
-	uint32_t *p = (uint32_t *)data;
-	const uint32_t *end = (uint32_t *)(data + AUDIO_BLOCK_SAMPLES);
-
-	do {
-		uint32_t tmp32 = *p; // read 2 samples from *data
-		int32_t val1 = signed_multiply_32x16b(mult, tmp32);
-		int32_t val2 = signed_multiply_32x16t(mult, tmp32);
-		val1 = signed_saturate_rshift(val1, 16, 0);
-		val2 = signed_saturate_rshift(val2, 16, 0);
-		*p++ = pack_16b_16b(val2, val1);
-	} while (p < end);
+	if (blocks < 0) blocks = 0;
+	if (blocks > 65535) blocks = 65535;
+	__disable_irq();
+	rampBlocks = blocks;
+	rampShape = shape;
+	rampRatio = (blocks > 0) ? powf(0.01f, 1.0f / blocks) * 65536.0f : 0;
+	__enable_irq();
 }
 
-static void applyGainThenAdd(int16_t *data, const int16_t *in, int32_t mult)
+// A new gain starts a ramp from where the crosspoint is now. update() runs from an interrupt,
+// so the ramp is set up with interrupts off.
+void AudioMixerMatrix::setTarget(unsigned int inChannel, unsigned int outChannel, int32_t mult)
 {
-	uint32_t *dst = (uint32_t *)data;
-	const uint32_t *src = (uint32_t *)in;
-	const uint32_t *end = (uint32_t *)(data + AUDIO_BLOCK_SAMPLES);
-
-	if (mult == MULTI_UNITYGAIN) {
-		do {
-			uint32_t tmp32 = *dst;
-			*dst++ = signed_add_16_and_16(tmp32, *src++);
-			tmp32 = *dst;
-			*dst++ = signed_add_16_and_16(tmp32, *src++);
-		} while (dst < end);
+	__disable_irq();
+	target[inChannel][outChannel] = mult;
+	if (rampBlocks == 0 || multiplier[inChannel][outChannel] == mult) {
+		multiplier[inChannel][outChannel] = mult;
+		rampLeft[inChannel][outChannel] = 0;
 	} else {
-		do {
-			uint32_t tmp32 = *src++; // read 2 samples from *data
-			int32_t val1 = signed_multiply_32x16b(mult, tmp32);
-			int32_t val2 = signed_multiply_32x16t(mult, tmp32);
-			val1 = signed_saturate_rshift(val1, 16, 0);
-			val2 = signed_saturate_rshift(val2, 16, 0);
-			tmp32 = pack_16b_16b(val2, val1);
-			uint32_t tmp32b = *dst;
-			*dst++ = signed_add_16_and_16(tmp32, tmp32b);
-		} while (dst < end);
+		rampLeft[inChannel][outChannel] = rampBlocks;
 	}
+	__enable_irq();
+	buildRoutes(outChannel);
 }
 
-#elif defined(KINETISL)
-#define MULTI_UNITYGAIN 256
-
-static void applyGain(int16_t *data, int32_t mult)
+// Gain at the end of this block for a ramping crosspoint
+int32_t AudioMixerMatrix::rampNext(unsigned int inChannel, unsigned int outChannel)
 {
-	const int16_t *end = data + AUDIO_BLOCK_SAMPLES;
+	int32_t now = multiplier[inChannel][outChannel];
+	int32_t gap = target[inChannel][outChannel] - now;
+	unsigned int left = rampLeft[inChannel][outChannel];
 
-	do {
-		int32_t val = *data * mult;
-		*data++ = signed_saturate_rshift(val, 16, 0);
-	} while (data < end);
+	if (left <= 1) return target[inChannel][outChannel];
+	if (rampShape == MM_RAMP_EXP)
+		return target[inChannel][outChannel] - (int32_t)(((int64_t)gap * rampRatio) >> 16);
+	return now + gap / (int32_t)left;
 }
 
-static void applyGainThenAdd(int16_t *dst, const int16_t *src, int32_t mult)
+// List the inputs routed to an output. update() runs from an interrupt, so the list is swapped in with interrupts off.
+void AudioMixerMatrix::buildRoutes(unsigned int outChannel)
 {
-	const int16_t *end = dst + AUDIO_BLOCK_SAMPLES;
+	uint8_t list[MMINMAX];
+	unsigned int inChannel, n = 0;
 
-	if (mult == MULTI_UNITYGAIN) {
-		do {
-			int32_t val = *dst + *src++;
-			*dst++ = signed_saturate_rshift(val, 16, 0);
-		} while (dst < end);
-	} else {
-		do {
-			int32_t val = *dst + ((*src++ * mult) >> 8); // overflow possible??
-			*dst++ = signed_saturate_rshift(val, 16, 0);
-		} while (dst < end);
+	for (inChannel=0; inChannel < MMINMAX; inChannel++) {
+		if (multiplier[inChannel][outChannel] != 0 || target[inChannel][outChannel] != 0)
+			list[n++] = inChannel;
 	}
+	__disable_irq();
+	memcpy(routes[outChannel], list, n);
+	routeCount[outChannel] = n;
+	__enable_irq();
 }
 
-#endif
-
 void AudioMixerMatrix::update(void)
 {
-	audio_block_t *in[MMINMAX], *out=NULL;
-	unsigned int inChannel, outChannel;
-	unsigned int sample;
+	audio_block_t *in[MMINMAX], *out;
+	unsigned int inChannel, outChannel, r;
+	int32_t mult, next[MMINMAX], change[MMINMAX];
+	bool ended, failed;
 	
 	// get the incoming audio_blocks
-	for (inChannel=0; inChannel < inChannels; inChannel++) {
-		in[inChannel] = receiveReadOnly(inChannel); 
+	for (inChannel=0; inChannel < MMINMAX; inChannel++) {
+		in[inChannel] = (inChannel < inChannels) ? receiveReadOnly(inChannel) : NULL;
 	}
 	
-	// crosspoint mix
+	// crosspoint mix: only the routes listed. The first input present starts the output block,
+	// so an output with no routes, or none with a block, transmits nothing.
+	// Ramping crosspoints move from multiplier to exactly next across the block; settled ones have no change.
 	for (outChannel=0; outChannel < outChannels; outChannel++) {		
-		out = allocate();		//get an audio_block that we'll sum the other channels to
-		for(sample=0; sample < AUDIO_BLOCK_SAMPLES; sample++){
-			out->data[sample] = 0; // slightly faster than memset()?
-		}
-		// OR memset(out->data, 0, AUDIO_BLOCK_SAMPLES * sizeof(int16_t)); 
-		
-		if(out){
-			for (inChannel=0; inChannel < inChannels; inChannel++) {
-				if (in[inChannel]) {
-					applyGainThenAdd(out->data, in[inChannel]->data, multiplier[inChannel][outChannel]);	
-				}
+		out = NULL;
+		failed = false;
+		for (r=0; r < routeCount[outChannel]; r++) {
+			inChannel = routes[outChannel][r];
+			mult = multiplier[inChannel][outChannel];
+			change[r] = 0;
+			if (rampLeft[inChannel][outChannel]) {
+				next[r] = rampNext(inChannel, outChannel);
+				change[r] = RAMP_CHANGE(next[r] - mult);
+			}
+			if (!in[inChannel] || failed) continue;
+			if (out) {
+				applyGainThenAdd(out->data, in[inChannel]->data, mult, change[r]);
+			} else {
+				out = allocate();
+				if (out) applyGain(out->data, in[inChannel]->data, mult, change[r]);
+				else failed = true;
 			}
+		}
+		// ramps run on with or without blocks, so they stay in time
+		ended = false;
+		for (r=0; r < routeCount[outChannel]; r++) {
+			inChannel = routes[outChannel][r];
+			if (!rampLeft[inChannel][outChannel]) continue;
+			multiplier[inChannel][outChannel] = next[r];
+			if (--rampLeft[inChannel][outChannel] == 0) ended = true;
+		}
+		if (ended) buildRoutes(outChannel); // drop crosspoints that reached zero
+		if (out) {
 			transmit(out, outChannel);
 			release(out);
 		}
@@ -1,5 +1,7 @@
 /* Matrix Mixer for the TeensyAudio Library (3.X & 4.X)
  * Mix N signals into N outputs (4 <= N <= 16).
+ * Only crosspoints with a non-zero gain are mixed: each output keeps a list of them.
+ * A gain change ramps over setRamp() blocks inside the mix kernels; settled gains take the plain kernels.
  * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
  *
  * Modified by Macaba, palmerr23 (2019, 2025)
@@ -37,6 +39,9 @@
 #define MMOUTPUTS 4
 #define MMINMAX	  16 // Biggest values 
 #define MMOUTMAX  16
+#define MMRAMP    1  // default gain ramp, in audio blocks
+#define MM_RAMP_LINEAR 0 // setRamp() shapes
+#define MM_RAMP_EXP    1 // each block closes the gap by the same ratio: 1% left at the end, then the target
 
 class AudioMixerMatrix : public AudioStream
 {
@@ -46,8 +51,12 @@ public:
 		inChannels = inCh;
 		outChannels = outCh;
 		for (int i=0; i< MMINMAX; i++) 
-			for(int j=0; j<MMOUTMAX; j++) 
-				multiplier[i][j] = 65536;
+			for(int j=0; j<MMOUTMAX; j++) {
+				multiplier[i][j] = target[i][j] = 65536;
+				rampLeft[i][j] = 0;
+			}
+		for (int j=0; j < MMOUTMAX; j++)
+			buildRoutes(j);
 	}
 	virtual void update(void);
 	void gain(unsigned int inChannel, unsigned int outChannel,  float gain) {
@@ -55,12 +64,26 @@ public:
 		if (inChannel >= MMINMAX) return;
 		if (gain > 32767.0f) gain = 32767.0f;
 		else if (gain < -32767.0f) gain = -32767.0f;
-		multiplier[inChannel][outChannel] = gain * 65536.0f; // TODO: proper roundoff?
+		setTarget(inChannel, outChannel, gain * 65536.0f); // TODO: proper roundoff?
 	}
+	// Ramp length for later gain changes, in audio blocks (0 = step), and its shape
+	void setRamp(int blocks, int shape = MM_RAMP_LINEAR);
 private:
+	void setTarget(unsigned int inChannel, unsigned int outChannel, int32_t mult);
+	int32_t rampNext(unsigned int inChannel, unsigned int outChannel);
+	void buildRoutes(unsigned int outChannel);
 	int32_t multiplier[MMINMAX][MMOUTMAX]; 
 	audio_block_t *inputQueueArray[MMINMAX];
 	uint8_t inChannels, outChannels;
+	// sparse crosspoints: the inputs with a non-zero gain or ramp, per output
+	uint8_t routes[MMOUTMAX][MMINMAX];
+	uint8_t routeCount[MMOUTMAX];
+	// ramps: multiplier moves to target over rampLeft more blocks
+	int32_t target[MMINMAX][MMOUTMAX];
+	uint16_t rampLeft[MMINMAX][MMOUTMAX];
+	uint16_t rampBlocks = MMRAMP;
+	uint8_t rampShape = MM_RAMP_LINEAR;
+	int32_t rampRatio = 0; // MM_RAMP_EXP: gap kept per block, Q16
 
 #elif defined(KINETISL)
 public:
@@ -69,7 +92,10 @@ public:
 		outChannels = outCh;
 		for (int i=0; i< MMINMAX; i++) 
 			for(int j=0; j<MMOUTMAX; j++) 
-				multiplier[i][j] = multiplier[i][j] = 256;
+				multiplier[i][j] = target[i][j] = 256;
+		memset(rampLeft, 0, sizeof(rampLeft));
+		for (int j=0; j < MMOUTMAX; j++)
+			buildRoutes(j);
 	}
 	virtual void update(void);
 	void gain(unsigned int inChannel, unsigned int outChannel, float gain) {
@@ -77,12 +103,23 @@ public:
 		if (inChannel >= MMINMAX) return;
 		if (gain > 127.0f) gain = 127.0f;
 		else if (gain < -127.0f) gain = -127.0f;
-		multiplier[inChannel][outChannel] = gain * 256.0f; // TODO: proper roundoff?
+		setTarget(inChannel, outChannel, gain * 256.0f); // TODO: proper roundoff?
 	}
+	void setRamp(int blocks, int shape = MM_RAMP_LINEAR);
 private:
+	void setTarget(unsigned int inChannel, unsigned int outChannel, int32_t mult);
+	int32_t rampNext(unsigned int inChannel, unsigned int outChannel);
+	void buildRoutes(unsigned int outChannel);
 	int16_t multiplier[MMINMAX][MMOUTMAX];
 	audio_block_t *inputQueueArray[MMINMAX];
 	uint8_t inChannels, outChannels;
+	uint8_t routes[MMOUTMAX][MMINMAX];
+	uint8_t routeCount[MMOUTMAX];
+	int16_t target[MMINMAX][MMOUTMAX];
+	uint16_t rampLeft[MMINMAX][MMOUTMAX];
+	uint16_t rampBlocks = MMRAMP;
+	uint8_t rampShape = MM_RAMP_LINEAR;
+	int32_t rampRatio = 0;
 #endif
 };
 
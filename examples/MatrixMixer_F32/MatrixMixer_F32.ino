@@ -0,0 +1,205 @@
+/*
+ * MatrixMixer_F32.ino
+ * TLV320AIC3104 TDM_32 example: float matrix mixer
+ *
+ * 8x8 matrix mixer between AudioInputTDM_32 and AudioOutputTDM_32 (one board).
+ * A sine generator feeds mixer input 0; it is panned between outputs 0 and 1 with ramped gains.
+ *
+ * At startup the mixer kernels are timed on synthetic blocks for a 16x16 matrix,
+ * dense (all 256 crosspoints) and sparse (20 crosspoints), with fixed and with ramping gains,
+ * against a plain loop that zeroes each output and adds every input. Every output sample
+ * is checked against that loop. No CODEC is needed for that part.
+ *
+ * Board USB Type must include SERIAL
+ */
+
+#include <Audio.h>
+#include "OpenAudio_ArduinoLibrary.h"
+#include "AudioStream_F32.h"
+#include "output_tdm32.h"
+#include "input_tdm32.h"
+#include "mixerMatrix_F32.h"
+#include <Wire.h>
+#include "control_tlv320aic3104.h"
+
+#define SAMPLERATE 44100.0f
+#define SAMPLEWIDTH 32
+#define CODECS 4
+#define CHANNELS (CODECS * 2)
+#define BLOX 40
+#define RST_PIN 22
+
+const float sample_rate_Hz = SAMPLERATE;
+const int   audio_block_samples = 128;    // Always 128, which is AUDIO_BLOCK_SAMPLES from AudioStream.h
+AudioSettings_F32 audio_settings(sample_rate_Hz, audio_block_samples);
+
+AudioInputTDM_32             tdm_in(SAMPLEWIDTH);
+AudioSynthSineCosine_F32     sine1;
+AudioMixerMatrix_F32         mixer(CHANNELS, CHANNELS);
+AudioOutputTDM_32            tdm_out(SAMPLEWIDTH);
+
+AudioConnection_F32          acIn[CHANNELS];  // sine or CODEC to mixer
+AudioConnection_F32          acOut[CHANNELS]; // mixer to CODEC
+
+AudioControlTLV320AIC3104 aic(CODECS, true, AICMODE_TDM, SAMPLERATE, SAMPLEWIDTH);
+
+/******************************* benchmark *******************************/
+#define BENCH_N 16
+#define RUNS 20
+
+float32_t bench_in[BENCH_N][AUDIO_BLOCK_SAMPLES];
+float32_t bench_ref[BENCH_N][AUDIO_BLOCK_SAMPLES];
+float32_t bench_out[BENCH_N][AUDIO_BLOCK_SAMPLES];
+float32_t bench_gain[BENCH_N][BENCH_N]; // [out][in], 0 = no crosspoint
+float32_t bench_step[BENCH_N][BENCH_N]; // per sample, 0 = not ramping
+
+// the loop the matrix replaces: zero each output, then every input at its gain
+static void mixReference(void)
+{
+  for (int o = 0; o < BENCH_N; o++) {
+    for (int j = 0; j < AUDIO_BLOCK_SAMPLES; j++)
+      bench_ref[o][j] = 0.0f;
+    for (int i = 0; i < BENCH_N; i++)
+      for (int j = 0; j < AUDIO_BLOCK_SAMPLES; j++)
+        bench_ref[o][j] += (bench_gain[o][i] + bench_step[o][i] * j) * bench_in[i][j];
+  }
+}
+
+// as AudioMixerMatrix_F32::update(): the fixed gains from the route list four inputs per pass, then the ramps
+static void mixSparse(void)
+{
+  const float32_t *in[BENCH_N];
+  float32_t g[BENCH_N];
+
+  for (int o = 0; o < BENCH_N; o++) {
+    int n = 0;
+    bool add;
+    for (int i = 0; i < BENCH_N; i++) {
+      if (bench_gain[o][i] != 0.0f && bench_step[o][i] == 0.0f) {
+        in[n] = bench_in[i];
+        g[n++] = bench_gain[o][i];
+      }
+    }
+    mmf_mix(bench_out[o], in, g, n, false);
+    add = (n > 0);
+    for (int i = 0; i < BENCH_N; i++) {
+      if (bench_step[o][i] != 0.0f) {
+        mmf_mix_ramp(bench_out[o], bench_in[i], bench_gain[o][i], bench_step[o][i], add);
+        add = true;
+      }
+    }
+    if (!add) memset(bench_out[o], 0, sizeof(bench_out[o])); // as no block
+  }
+}
+
+uint32_t timeMix(void (*fn)(void))
+{
+  uint32_t start, best = 0xFFFFFFFF;
+  for (int run = 0; run < RUNS; run++) {
+    start = ARM_DWT_CYCCNT;
+    fn();
+    best = min(best, ARM_DWT_CYCCNT - start);
+  }
+  return best;
+}
+
+void report(const char *name, uint32_t cycles)
+{
+  float cpu = 100.0f * cycles * (AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES) / F_CPU_ACTUAL;
+  Serial.printf("  %-10s %7lu cycles/block, %.2f%% CPU\n", name, cycles, cpu);
+}
+
+// largest difference over every output sample
+float compare(void)
+{
+  float worst = 0.0f;
+  for (int o = 0; o < BENCH_N; o++)
+    for (int j = 0; j < AUDIO_BLOCK_SAMPLES; j++)
+      worst = max(worst, fabsf(bench_ref[o][j] - bench_out[o][j]));
+  return worst;
+}
+
+void benchmark(void)
+{
+  static const char *patterns[4] = {"dense", "sparse", "sparse, 4 ramping", "dense, all ramping"};
+
+  randomSeed(1);
+  for (int i = 0; i < BENCH_N; i++)
+    for (int j = 0; j < AUDIO_BLOCK_SAMPLES; j++)
+      bench_in[i][j] = random(-10000, 10000) / 10000.0f;
+
+  for (int pattern = 0; pattern < 4; pattern++) {
+    int count = 0, ramps = 0;
+    for (int o = 0; o < BENCH_N; o++)
+      for (int i = 0; i < BENCH_N; i++) {
+        bool extra = (o < 4 && i == o + 8);
+        bool on = (pattern == 0 || pattern == 3) || (i == o) || extra; // sparse: diagonal plus 4
+        bool ramp = (pattern == 3) || (pattern == 2 && extra);
+        bench_gain[o][i] = on ? 0.5f : 0.0f;
+        bench_step[o][i] = ramp ? 0.25f / AUDIO_BLOCK_SAMPLES : 0.0f; // 0.5 to 0.75 across the block
+        count += on;
+        ramps += ramp;
+      }
+    Serial.printf("%ix%i %s: %i crosspoints, %i ramping\n", BENCH_N, BENCH_N, patterns[pattern], count, ramps);
+    uint32_t ref = timeMix(mixReference);
+    uint32_t sparse = timeMix(mixSparse);
+    float diff = compare();
+    report("reference", ref);
+    report("matrix", sparse);
+    Serial.printf("  results %s (max difference %.2e), speedup %.2fx\n\n",
+      diff < 1e-4f ? "match" : "DIFFER", diff, (float)ref / sparse);
+  }
+}
+
+/********************************* demo **********************************/
+void setup()
+{
+  AudioMemory_F32(BLOX);
+  Serial.begin(115200);
+  while (!Serial && millis() < 3000) ;
+  Serial.println("\n\nT4 TDM_32 float matrix mixer");
+
+  benchmark();
+
+  for (int chan = 0; chan < CHANNELS; chan++) {
+    if (chan == 0)
+      acIn[chan].connect(sine1, 0, mixer, chan);
+    else
+      acIn[chan].connect(tdm_in, chan, mixer, chan);
+    acOut[chan].connect(mixer, chan, tdm_out, chan);
+    for (int chanB = 0; chanB < CHANNELS; chanB++) // all crosspoints off, then straight through
+      mixer.gain(chan, chanB, (chan == chanB) ? 1.0f : 0.0f);
+  }
+  mixer.setRamp(40); // ~120 mS pans
+
+  Wire.begin();
+  Wire.setClock(400000);
+  aic.setVerbose(0);
+  int boardsFound = aic.begin(RST_PIN);
+  Serial.printf("Boards found %i\n", boardsFound);
+
+  aic.inputMode(AIC_DIFF);
+  if (!aic.enable(CH_BOTH)) // After enable() DAC and ADC are muted
+    Serial.println("Failed to init codecs");
+  aic.volume(1, CH_BOTH, AIC_ALL_CODECS);  // muted on startup
+  aic.inputLevel(0, CH_BOTH, AIC_ALL_CODECS); //db
+
+  sine1.frequency(500);
+  sine1.amplitude(0.4);
+  Serial.println("Done setup");
+}
+
+uint32_t vTimer;
+#define PROCESS_EVERY 2000
+bool left = true;
+void loop()
+{
+  if (millis() > vTimer + PROCESS_EVERY) {
+    vTimer = millis();
+    left = !left;
+    mixer.gain(0, 0, left ? 1.0f : 0.0f); // the ramps make the pan click-free
+    mixer.gain(0, 1, left ? 0.0f : 1.0f);
+    Serial.printf("sine %s, audioProc %2.1f%%, audioMem %i\n", left ? "left " : "right",
+      AudioProcessorUsage(), AudioMemoryUsage_F32());
+  }
+}
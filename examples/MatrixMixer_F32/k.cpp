@@ -0,0 +1,4 @@
+#include <cstdint>
+typedef float float32_t;
+#define AUDIO_BLOCK_SAMPLES 128
+#include "k.inc"
@@ -0,0 +1,199 @@
+/* Matrix Mixer for the OpenAudio F32 library (Teensy 4.X)
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#include <Arduino.h>
+#include "mixerMatrix_F32.h"
+
+// K inputs into out, four samples per pass: the accumulators stay in FPU registers
+// and the first input of a fresh output writes it, so there is no zeroing pass.
+template <int K, bool ADD>
+static inline void mmf_pass(float32_t *out, const float32_t * const *in, const float32_t *g)
+{
+	float32_t a0, a1, a2, a3;
+
+	for (int j = 0; j < AUDIO_BLOCK_SAMPLES; j += 4) {
+		if (ADD) {
+			a0 = out[j];
+			a1 = out[j+1];
+			a2 = out[j+2];
+			a3 = out[j+3];
+		} else {
+			a0 = g[0] * in[0][j];
+			a1 = g[0] * in[0][j+1];
+			a2 = g[0] * in[0][j+2];
+			a3 = g[0] * in[0][j+3];
+		}
+		for (int k = ADD ? 0 : 1; k < K; k++) { // unrolled: K is a constant
+			const float32_t *p = in[k] + j;
+			a0 += g[k] * p[0];
+			a1 += g[k] * p[1];
+			a2 += g[k] * p[2];
+			a3 += g[k] * p[3];
+		}
+		out[j] = a0;
+		out[j+1] = a1;
+		out[j+2] = a2;
+		out[j+3] = a3;
+	}
+}
+
+template <int K>
+static inline void mmf_pass(float32_t *out, const float32_t * const *in, const float32_t *g, bool add)
+{
+	if (add)
+		mmf_pass<K, true>(out, in, g);
+	else
+		mmf_pass<K, false>(out, in, g);
+}
+
+void mmf_mix(float32_t *out, const float32_t * const *in, const float32_t *gain, int n, bool add)
+{
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		mmf_pass<4>(out, in + i, gain + i, add);
+		add = true;
+	}
+	switch (n - i) {
+	case 3: mmf_pass<3>(out, in + i, gain + i, add); break;
+	case 2: mmf_pass<2>(out, in + i, gain + i, add); break;
+	case 1: mmf_pass<1>(out, in + i, gain + i, add); break;
+	}
+}
+
+void mmf_mix_ramp(float32_t *out, const float32_t *in, float32_t gain, float32_t step, bool add)
+{
+	for (int j = 0; j < AUDIO_BLOCK_SAMPLES; j++) {
+		out[j] = add ? out[j] + gain * in[j] : gain * in[j];
+		gain += step;
+	}
+}
+
+AudioMixerMatrix_F32::AudioMixerMatrix_F32(uint8_t inCh, uint8_t outCh)
+	: AudioStream_F32((inCh > MMF_MAX) ? MMF_MAX : inCh, inputQueueArray)
+{
+	inChannels = (inCh > MMF_MAX) ? MMF_MAX : inCh;
+	outChannels = (outCh > MMF_MAX) ? MMF_MAX : outCh;
+	for (int o = 0; o < MMF_MAX; o++) {
+		for (int i = 0; i < MMF_MAX; i++) {
+			target[o][i] = now[o][i] = rampTo[o][i] = 1.0f;
+			step[o][i] = 0.0f;
+			rampLeft[o][i] = 0;
+		}
+		dirty[o] = 0;
+		buildRoutes(o);
+	}
+}
+
+void AudioMixerMatrix_F32::gain(unsigned int inChannel, unsigned int outChannel, float gain)
+{
+	if (outChannel >= MMF_MAX) return;
+	if (inChannel >= MMF_MAX) return;
+	__disable_irq();
+	target[outChannel][inChannel] = gain;
+	dirty[outChannel] |= 1UL << inChannel;
+	__enable_irq();
+}
+
+// Pick up new targets: each starts a ramp from the gain now
+void AudioMixerMatrix_F32::startRamps(void)
+{
+	uint32_t bits;
+	unsigned int o, i;
+
+	for (o = 0; o < outChannels; o++) {
+		if (!dirty[o]) continue;
+		__disable_irq();
+		bits = dirty[o];
+		dirty[o] = 0;
+		__enable_irq();
+		for (i = 0; bits; i++, bits >>= 1) {
+			if (!(bits & 1)) continue;
+			rampTo[o][i] = target[o][i];
+			if (rampBlocks == 0 || rampTo[o][i] == now[o][i]) {
+				now[o][i] = rampTo[o][i];
+				rampLeft[o][i] = 0;
+			} else {
+				step[o][i] = (rampTo[o][i] - now[o][i]) / (rampBlocks * AUDIO_BLOCK_SAMPLES);
+				rampLeft[o][i] = rampBlocks;
+			}
+		}
+		buildRoutes(o);
+	}
+}
+
+void AudioMixerMatrix_F32::buildRoutes(unsigned int outChannel)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < MMF_MAX; i++) {
+		if (now[outChannel][i] != 0.0f || rampLeft[outChannel][i])
+			routes[outChannel][n++] = i;
+	}
+	routeCount[outChannel] = n;
+}
+
+void AudioMixerMatrix_F32::update(void)
+{
+	audio_block_f32_t *in[MMF_MAX], *out;
+	const float32_t *fixedIn[MMF_MAX];
+	float32_t fixedGain[MMF_MAX];
+	unsigned int i, o, r, n;
+	bool add, ended, live;
+
+	for (i = 0; i < MMF_MAX; i++)
+		in[i] = (i < inChannels) ? receiveReadOnly_f32(i) : NULL;
+	startRamps();
+
+	for (o = 0; o < outChannels; o++) {
+		// fixed gains go four at a time; ramps one by one
+		out = NULL;
+		add = false;
+		ended = false;
+		n = 0;
+		for (r = 0; r < routeCount[o]; r++) {
+			i = routes[o][r];
+			if (in[i] && !rampLeft[o][i]) {
+				fixedIn[n] = in[i]->data;
+				fixedGain[n++] = now[o][i];
+			}
+		}
+		live = (n > 0);
+		for (r = 0; !live && r < routeCount[o]; r++) {
+			i = routes[o][r];
+			live = (in[i] && rampLeft[o][i]);
+		}
+		if (live) out = allocate_f32();
+		if (out) {
+			mmf_mix(out->data, fixedIn, fixedGain, n, false);
+			add = (n > 0);
+		}
+		for (r = 0; r < routeCount[o]; r++) {
+			i = routes[o][r];
+			if (!rampLeft[o][i]) continue;
+			if (out && in[i]) {
+				mmf_mix_ramp(out->data, in[i]->data, now[o][i], step[o][i], add);
+				add = true;
+			}
+			// the ramp runs on without a block, so it stays in time
+			if (--rampLeft[o][i] == 0) {
+				now[o][i] = rampTo[o][i];
+				ended = true;
+			} else {
+				now[o][i] += step[o][i] * AUDIO_BLOCK_SAMPLES;
+			}
+		}
+		if (ended) buildRoutes(o); // drop crosspoints that reached zero
+		if (out) {
+			transmit(out, o);
+			release(out);
+		}
+	}
+
+	for (i = 0; i < inChannels; i++) {
+		if (in[i]) release(in[i]);
+	}
+}
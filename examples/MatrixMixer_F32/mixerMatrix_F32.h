@@ -0,0 +1,56 @@
+/* Matrix Mixer for the OpenAudio F32 library (Teensy 4.X)
+ * Mix up to 32 float signals into up to 32 outputs.
+ * Each output keeps a list of its crosspoints with a non-zero gain, and only those are mixed.
+ * The kernels take four inputs per pass over the output block, so each output sample
+ * is loaded and stored once for every four inputs. A gain change ramps linearly
+ * over setRamp() blocks, inside the kernel.
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef mixerMatrix_F32_h_
+#define mixerMatrix_F32_h_
+
+#include "Arduino.h"
+#include "AudioStream_F32.h"
+
+#define MMF_INPUTS   8 // default numbers for inputs and outputs
+#define MMF_OUTPUTS  8
+#define MMF_MAX      32 // Biggest value for both
+#define MMF_RAMP     1  // default gain ramp, in audio blocks
+
+// Kernels, public for benchmarking.
+// n inputs at fixed gains into out. add: accumulate into out, otherwise overwrite it.
+void mmf_mix(float32_t *out, const float32_t * const *in, const float32_t *gain, int n, bool add);
+// One input at a gain ramping from gain by step per sample
+void mmf_mix_ramp(float32_t *out, const float32_t *in, float32_t gain, float32_t step, bool add);
+
+class AudioMixerMatrix_F32 : public AudioStream_F32
+{
+public:
+	AudioMixerMatrix_F32(uint8_t inCh = MMF_INPUTS, uint8_t outCh = MMF_OUTPUTS);
+	virtual void update(void);
+	// Crosspoint gain, linear: negative inverts. Reached by a ramp, picked up at the next update().
+	void gain(unsigned int inChannel, unsigned int outChannel, float gain);
+	// Ramp length for later gain changes, in audio blocks; 0 = step at the next block.
+	void setRamp(int blocks) { rampBlocks = (blocks < 0) ? 0 : blocks; }
+private:
+	void startRamps(void);
+	void buildRoutes(unsigned int outChannel);
+	audio_block_f32_t *inputQueueArray[MMF_MAX];
+	uint8_t inChannels, outChannels;
+	uint16_t rampBlocks = MMF_RAMP;
+	// written by gain(): dirty holds one bit per input of each output with a new target
+	float32_t target[MMF_MAX][MMF_MAX];	// [out][in]
+	volatile uint32_t dirty[MMF_MAX];
+	// owned by update()
+	float32_t now[MMF_MAX][MMF_MAX];	// gain at the start of the next block
+	float32_t step[MMF_MAX][MMF_MAX];	// per sample while ramping
+	float32_t rampTo[MMF_MAX][MMF_MAX];
+	uint16_t rampLeft[MMF_MAX][MMF_MAX];	// blocks
+	uint8_t routes[MMF_MAX][MMF_MAX];	// inputs with a gain, or ramping
+	uint8_t routeCount[MMF_MAX];
+};
+
+#endif
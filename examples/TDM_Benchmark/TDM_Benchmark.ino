@@ -0,0 +1,152 @@
+/*
+ * TDM_Benchmark.ino
+ * Cycle counts for the TDM_A interleave/deinterleave kernels (memcpy_tdm.h)
+ * No CODEC board or audio objects are needed - kernels run on a synthetic DMA buffer.
+ * 
+ * Compares the packed (PKHTB/PKHBT) kernel with the original one-sample-per-store loop
+ * for 8 (one board) and 16 (two boards) channels.
+ * The transmit side is timed with all 16 outputs live and with a sparse patch (3 live outputs),
+ * following the same per-pair logic as AudioOutputTDM_A::isr().
+ * Both directions check the packed kernels' output against the original loops.
+ * The ISR runs once per block: 44100 / AUDIO_BLOCK_SAMPLES = 344 times a second.
+ */
+
+#include <Audio.h>
+#include "memcpy_tdm.h"
+
+#define RUNS 100
+
+DMAMEM __attribute__((aligned(32))) uint32_t rx_buffer[AUDIO_BLOCK_SAMPLES * TDM_A_FRAME_WORDS]; // one half buffer
+int16_t block_data[16][AUDIO_BLOCK_SAMPLES];
+int16_t check_data[16][AUDIO_BLOCK_SAMPLES];
+DMAMEM __attribute__((aligned(32))) uint32_t tx_buffer[AUDIO_BLOCK_SAMPLES * TDM_A_FRAME_WORDS];
+uint32_t tx_check[AUDIO_BLOCK_SAMPLES * TDM_A_FRAME_WORDS];
+uint32_t zeros[AUDIO_BLOCK_SAMPLES/2];
+uint8_t tx_silent = 0;
+
+// original driver loop: one 16-bit store per sample
+static void memcpy_tdm_rx_16_ref(uint16_t *dest1, uint16_t *dest2, const uint32_t *src)
+{
+  uint32_t i, in1;
+  for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    in1 = *src;
+    *dest1++ = (uint16_t)((in1 >> 16) & 0x0000FFFF);
+    *dest2++ = (uint16_t)(in1 & 0x0000FFFF);
+    src += 8;
+  }
+}
+
+// original driver loop: two frames per pass, shift and mask for every pair
+static void memcpy_tdm_tx_ref(uint32_t *dest, const uint32_t *src1, const uint32_t *src2)
+{
+  uint32_t i, in1, in2;
+  for (i=0; i < AUDIO_BLOCK_SAMPLES/2; i++) {
+    in1 = *src1++;
+    in2 = *src2++;
+    *dest = (in1 << 16) | (in2 & 0xFFFF);
+    *(dest + 8) = (in1 & 0xFFFF0000) | (in2 >> 16);
+    dest += 16;
+  }
+}
+
+// live: bit mask of channels with a block
+uint32_t timeTx(uint16_t live, bool packed)
+{
+  uint32_t start, best = 0xFFFFFFFF;
+  for (int run = 0; run < RUNS; run++)
+  {
+    start = ARM_DWT_CYCCNT;
+    uint32_t *dest = tx_buffer;
+    for (int i = 0; i < 16; i += 2)
+    {
+      uint8_t pair = 1 << (i >> 1);
+      const uint32_t *src1 = (live & (1 << i)) ? (uint32_t *)block_data[i] : zeros;
+      const uint32_t *src2 = (live & (2 << i)) ? (uint32_t *)block_data[i+1] : zeros;
+      if (!packed)
+        memcpy_tdm_tx_ref(dest, src1, src2);
+      else if (src1 != zeros || src2 != zeros)
+      {
+        memcpy_tdm_tx(dest, src1, src2);
+        tx_silent &= ~pair;
+      }
+      else if (!(tx_silent & pair))
+      {
+        memset_tdm_tx(dest);
+        tx_silent |= pair;
+      }
+      dest++;
+    }
+    best = min(best, ARM_DWT_CYCCNT - start);
+  }
+  return best;
+}
+
+uint32_t timeRx(int channels, bool packed)
+{
+  uint32_t start, best = 0xFFFFFFFF;
+  for (int run = 0; run < RUNS; run++)
+  {
+    start = ARM_DWT_CYCCNT;
+    const uint32_t *src = rx_buffer;
+    for (int i = 0; i < channels; i += 2)
+    {
+      if (packed)
+        memcpy_tdm_rx_16(block_data[i], block_data[i+1], src);
+      else
+        memcpy_tdm_rx_16_ref((uint16_t *)check_data[i], (uint16_t *)check_data[i+1], src);
+      src++;
+    }
+    best = min(best, ARM_DWT_CYCCNT - start);
+  }
+  return best;
+}
+
+void report(const char *name, int channels, uint32_t cycles)
+{
+  float cpu = 100.0f * cycles * (AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES) / F_CPU_ACTUAL;
+  Serial.printf("%-10s %2i ch: %6lu cycles/block, %5.1f cycles/sample, %.3f%% CPU\n",
+    name, channels, cycles, (float)cycles / (channels * AUDIO_BLOCK_SAMPLES), cpu);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  while (!Serial && millis() < 3000) ;
+  Serial.println("\n\nTDM_A kernel benchmark");
+
+  randomSeed(1);
+  for (unsigned i = 0; i < sizeof(rx_buffer) / 4; i++)
+    rx_buffer[i] = random();
+  arm_dcache_flush(rx_buffer, sizeof(rx_buffer));
+
+  for (int channels = 8; channels <= 16; channels += 8)
+  {
+    uint32_t ref = timeRx(channels, false);
+    uint32_t packed = timeRx(channels, true);
+    report("reference", channels, ref);
+    report("packed", channels, packed);
+    bool ok = (memcmp(block_data, check_data, channels * sizeof(block_data[0])) == 0);
+    Serial.printf("packed output %s, speedup %.2fx\n\n", ok ? "matches" : "DIFFERS", (float)ref / packed);
+  }
+
+  // block_data now holds the received samples: the live outputs send those
+  uint16_t patterns[] = {0xFFFF, 0x0023}; // all live, 3 live outputs
+  for (uint16_t live : patterns)
+  {
+    Serial.printf("transmit, live outputs 0x%04X\n", live);
+    uint32_t ref = timeTx(live, false);
+    memcpy(tx_check, tx_buffer, sizeof(tx_buffer));
+    // the packed run starts on a dirty buffer with no pair known silent, so it must write every pair
+    memset(tx_buffer, 0xA5, sizeof(tx_buffer));
+    tx_silent = 0;
+    uint32_t packed = timeTx(live, true);
+    report("reference", 16, ref);
+    report("packed", 16, packed);
+    bool ok = (memcmp(tx_buffer, tx_check, sizeof(tx_buffer)) == 0);
+    Serial.printf("packed output %s, speedup %.2fx\n\n", ok ? "matches" : "DIFFERS", (float)ref / packed);
+  }
+}
+
+void loop()
+{
+}
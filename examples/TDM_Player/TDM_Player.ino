@@ -0,0 +1,128 @@
+/*
+ * TLV320AIC3104 TDM board multi-codec
+ * Multichannel player: one interleaved WAV file (up to 16 channels here) from the built-in SD card
+ *
+ * The frames go from the prefetch ring straight into the transmit buffer in the output driver's
+ * low-latency callback, so all tracks stay sample aligned and no audio blocks are used for them.
+ * Slots the file does not cover keep the audio graph output: here a sine on the last slot.
+ * Serial commands: p = play, l = play looped, s = stop, i = print the counters
+ * Uses TDMA Revised library
+ */
+
+#include "output_tdmA.h"
+#include "input_tdmA.h"
+#include <Audio.h>
+#include <Wire.h>
+#include <SD.h>
+#include "control_tlv320aic3104.h"
+#include "tdm_player.h"
+
+#define CODECS 8
+#define AUDIO_BLOCKS 8
+#define RST_PIN 22
+#define FILENAME "STEMS.WAV"
+
+// 16 x 16-bit channels at 44.1kHz are 1.4MB/S: the ring rides out slow SD reads.
+// With PSRAM fitted (Teensy 4.1) define RING_IN_PSRAM for a much longer buffer.
+//#define RING_IN_PSRAM
+#if defined(RING_IN_PSRAM)
+#define RING_BYTES (4 * 1024 * 1024)
+EXTMEM uint8_t ring[RING_BYTES];
+#else
+#define RING_BYTES (256 * 1024)
+DMAMEM uint8_t ring[RING_BYTES];
+#endif
+
+AudioInputTDM_A          tdm_in;
+AudioOutputTDM_A         tdm_out;
+AudioSynthWaveformSine   sine1;
+AudioConnection          patchCord1(sine1, 0, tdm_out, AudioOutputTDM_A::channels - 1);
+
+AudioControlTLV320AIC3104 aic(CODECS, true, AICMODE_TDM);
+TDMPlayer player(ring, RING_BYTES);
+
+// A stereo or 8 channel file would take slots 0.. in order. To place the file's channels
+// elsewhere, e.g. channel 0 on slots 0 and 4, channel 1 on slots 1 and 5:
+// const int8_t map[] = {0, 1, TDMPLAY_NONE, TDMPLAY_NONE, 0, 1};
+// player.setMap(map, 6);
+
+// Runs in the transmit ISR: tx already holds the audio graph output
+void playFrames(const uint32_t *rx, uint32_t *tx, int frames)
+{
+  player.fill(tx, frames);
+}
+
+void printStats(void)
+{
+  tdmplay_stats s;
+  player.getStats(s);
+  Serial.printf("%.1f S played, underruns %lu (%lu frames silent), ring min %lu%%, slowest read %lu uS, errors %lu\n",
+    (float)s.framesPlayed / AUDIO_SAMPLE_RATE_EXACT, s.underruns, s.framesSilent,
+    s.minFill * 100 / RING_BYTES, s.readMaxUs, s.readErrors);
+}
+
+void play(bool looped)
+{
+  if (!player.play(FILENAME, looped)) {
+    Serial.println("Could not play " FILENAME ": missing, or not 16/24/32-bit PCM");
+    return;
+  }
+  Serial.printf("Playing %s: %i channels at %lu Hz, %s\n", FILENAME, player.channels(), player.sampleRate(),
+    player.isDirect() ? "direct frame copy" : "mapped");
+  if (player.sampleRate() != (uint32_t)AUDIO_SAMPLE_RATE_EXACT)
+    Serial.println("Warning: the file's sample rate differs from the TDM rate");
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  while (!Serial && millis() < 3000) ;
+  AudioMemory(AUDIO_BLOCKS);
+  Serial.println("\n\nTDM multichannel player");
+
+  if (!SD.begin(BUILTIN_SDCARD))
+    Serial.println("No SD card");
+
+  Wire.begin();
+  aic.setVerbose(0);
+  int boardsFound = aic.begin(RST_PIN);
+  Serial.printf("Boards found %i\n", boardsFound);
+  if (!aic.enable())
+    Serial.println("Failed to init codecs");
+  aic.volume(0.8, CH_BOTH, AIC_ALL_CODECS);
+
+  sine1.frequency(440);
+  sine1.amplitude(0.3);
+
+  player.setOutput(AudioOutputTDM_A::stride, (TDM_A_WORD_BITS == 16) ? 16 : 32, TDM_A_TX_LINES);
+  tdm_out.setCallback(playFrames);
+  Serial.println("p = play, l = play looped, s = stop, i = counters");
+}
+
+uint32_t statsTimer;
+bool wasPlaying = false;
+void loop()
+{
+  if (!player.service())
+    Serial.println("SD read failed: playing out the buffer");
+
+  if (Serial.available()) {
+    char c = Serial.read();
+    if (c == 'p' || c == 'l')
+      play(c == 'l');
+    else if (c == 's')
+      player.stop();
+    else if (c == 'i')
+      printStats();
+  }
+
+  if (wasPlaying && !player.isPlaying()) {
+    Serial.println("Stopped");
+    printStats();
+  }
+  wasPlaying = player.isPlaying();
+  if (wasPlaying && millis() - statsTimer > 5000) {
+    statsTimer = millis();
+    printStats();
+  }
+}
@@ -0,0 +1,286 @@
+/* Multichannel WAV player feeding the TDM transmit buffer (Teensy 4.X)
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#include <Arduino.h>
+#include "tdm_player.h"
+
+static uint16_t get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t get32(const uint8_t *p) { return get16(p) | ((uint32_t)get16(p + 2) << 16); }
+static uint64_t get64(const uint8_t *p) { return get32(p) | ((uint64_t)get32(p + 4) << 32); }
+
+TDMPlayer::TDMPlayer(uint8_t *ringBuffer, uint32_t bytes)
+{
+	ring = ringBuffer;
+	size = bytes - bytes % TDMPLAY_CHUNK;
+	setOutput(8, 16, 1);
+}
+
+void TDMPlayer::setOutput(int words, int bits, int dataLines)
+{
+	int perWord, perLine, line, s;
+
+	stride = words;
+	slotBits = (bits == 16) ? 16 : 32;
+	lines = (dataLines < 1) ? 1 : dataLines;
+	perWord = 32 / slotBits;
+	perLine = (stride / lines) * perWord;
+	slots = min(perLine * lines, TDMPLAY_MAX_SLOTS);
+	// as on the wire: words of each line interleaved, the first of two 16-bit slots in the upper half
+	for (int n = 0; n < slots; n++) {
+		line = n / perLine;
+		s = n % perLine;
+		slotWord[n] = (s / perWord) * lines + line;
+		slotShift[n] = (perWord == 2 && !(s & 1)) ? 16 : 0;
+	}
+}
+
+void TDMPlayer::setMap(const int8_t *newMap, int count)
+{
+	mapCount = (newMap == nullptr) ? 0 : min(count, TDMPLAY_MAX_SLOTS);
+	for (int n = 0; n < mapCount; n++)
+		map[n] = newMap[n];
+}
+
+bool TDMPlayer::parseHeader(void)
+{
+	uint8_t h[40];
+	uint32_t len, n;
+	uint64_t next, ds64Data = 0;
+	uint16_t format, align, bits;
+	bool fmt = false;
+
+	if (file.read(h, 12) != 12) return false;
+	if ((memcmp(h, "RIFF", 4) && memcmp(h, "RF64", 4)) || memcmp(h + 8, "WAVE", 4)) return false;
+	while (file.read(h, 8) == 8) {
+		len = get32(h + 4);
+		next = file.position() + len + (len & 1);
+		if (!memcmp(h, "ds64", 4)) {
+			if (len < 28 || file.read(h, 28) != 28) return false;
+			ds64Data = get64(h + 8);
+		} else if (!memcmp(h, "fmt ", 4)) {
+			n = min(len, (uint32_t)sizeof(h));
+			if (len < 16 || file.read(h, n) != (int)n) return false;
+			format = get16(h);
+			if (format == 0xFFFE && len >= 26) format = get16(h + 24); // extensible: the sub format
+			fileChannels = get16(h + 2);
+			fileRate = get32(h + 4);
+			align = get16(h + 12);
+			bits = get16(h + 14);
+			fileBytes = bits / 8;
+			if (format != 1 || (bits != 16 && bits != 24 && bits != 32) || fileChannels == 0
+				|| align != fileChannels * fileBytes || align > TDMPLAY_MAX_FRAME)
+				return false;
+			frameBytes = align;
+			fmt = true;
+		} else if (!memcmp(h, "data", 4)) {
+			dataStart = file.position();
+			dataSize = (len == 0xFFFFFFFF && ds64Data) ? ds64Data : len;
+			dataSize -= dataSize % frameBytes;
+			return fmt && dataSize > 0;
+		}
+		file.seek(next);
+	}
+	return false;
+}
+
+bool TDMPlayer::play(const char *name, bool loop)
+{
+	int n, c;
+
+	stop();
+	file = SD.open(name, FILE_READ);
+	if (!file) return false;
+	frameBytes = 0;
+	if (!parseHeader()) {
+		file.close();
+		return false;
+	}
+	direct = (lines == 1 && !mapCount && fileChannels == slots && fileBytes * 8 == slotBits);
+	for (n = 0; n < slots; n++) {
+		c = mapCount ? ((n < mapCount) ? map[n] : TDMPLAY_NONE) : n;
+		slotChannel[n] = (c >= 0 && c < fileChannels) ? c : TDMPLAY_NONE;
+	}
+
+	head = tail = 0;
+	used = 0;
+	eof = rebuffer = false;
+	repeat = loop;
+	stats = {};
+	stats.minFill = size;
+	file.seek(dataStart);
+	dataLeft = dataSize;
+	while (!eof && size - used >= TDMPLAY_CHUNK) { // start with a full ring
+		if (!readChunk()) {
+			file.close();
+			return false;
+		}
+	}
+	playing = true;
+	return true;
+}
+
+void TDMPlayer::stop(void)
+{
+	playing = false;
+	if (file) file.close();
+}
+
+// One read, ending on a sector boundary of the file. Split if it wraps the ring.
+bool TDMPlayer::readChunk(void)
+{
+	uint32_t n, first, t;
+	bool ok;
+
+	if (dataLeft == 0) {
+		if (!repeat) {
+			eof = true;
+			return true;
+		}
+		file.seek(dataStart);
+		dataLeft = dataSize;
+	}
+	n = TDMPLAY_CHUNK - (dataStart + dataSize - dataLeft) % 512;
+	if (n > dataLeft) n = dataLeft;
+	t = micros();
+	first = min(n, size - head);
+	ok = (file.read(ring + head, first) == (int)first);
+	if (ok && first < n)
+		ok = (file.read(ring, n - first) == (int)(n - first));
+	t = micros() - t;
+	if (t > stats.readMaxUs) stats.readMaxUs = t;
+	if (!ok) {
+		stats.readErrors++;
+		return false;
+	}
+	head = (head + n) % size;
+	__disable_irq();
+	used += n;
+	__enable_irq();
+	dataLeft -= n;
+	return true;
+}
+
+bool TDMPlayer::service(void)
+{
+	if (!playing) {
+		if (file) file.close();
+		return true;
+	}
+	while (!eof && size - used >= TDMPLAY_CHUNK) {
+		if (!readChunk()) {
+			eof = true; // play out what is in the ring
+			return false;
+		}
+	}
+	return true;
+}
+
+// The player's slots only: the others keep the audio graph output
+void TDMPlayer::silence(uint32_t *tx, int frames)
+{
+	if (direct) {
+		memset(tx, 0, frames * stride * 4);
+		return;
+	}
+	for (int f = 0; f < frames; f++, tx += stride) {
+		for (int n = 0; n < slots; n++) {
+			if (slotChannel[n] < 0) continue;
+			if (slotBits == 16)
+				tx[slotWord[n]] &= ~(0xFFFFu << slotShift[n]);
+			else
+				tx[slotWord[n]] = 0;
+		}
+	}
+}
+
+void TDMPlayer::fill(uint32_t *tx, int frames)
+{
+	uint8_t tmp[TDMPLAY_MAX_FRAME];
+	const uint8_t *fp, *p;
+	uint32_t avail, first, w;
+	int32_t v;
+	int n, f, s;
+
+	if (!playing || tx == nullptr) return;
+	avail = used;
+	if (avail < stats.minFill) stats.minFill = avail;
+	if (rebuffer) {
+		if (avail < size / 2 && !eof) {
+			silence(tx, frames);
+			stats.framesSilent += frames;
+			return;
+		}
+		rebuffer = false;
+	}
+	n = min((uint32_t)frames, avail / frameBytes);
+
+	if (direct) {
+		// the file frame is the wire frame: tail stays word aligned
+		uint32_t words = n * stride, *dest = tx;
+		const uint32_t *src;
+		while (words) {
+			first = min(words, (size - tail) / 4);
+			src = (const uint32_t *)(ring + tail);
+			if (slotBits == 16) {
+				for (uint32_t i = 0; i < first; i++) {
+					w = src[i];
+					dest[i] = (w >> 16) | (w << 16);	// first slot to the upper half
+				}
+			} else {
+				memcpy(dest, src, first * 4);
+			}
+			dest += first;
+			words -= first;
+			tail = (tail + first * 4) % size;
+		}
+	} else {
+		for (f = 0; f < n; f++, tx += stride) {
+			fp = ring + tail;
+			if (tail + frameBytes > size) { // frame wraps the ring
+				first = size - tail;
+				memcpy(tmp, fp, first);
+				memcpy(tmp + first, ring, frameBytes - first);
+				fp = tmp;
+			}
+			for (s = 0; s < slots; s++) {
+				if (slotChannel[s] < 0) continue;
+				p = fp + slotChannel[s] * fileBytes;
+				if (fileBytes == 2)
+					v = (int32_t)get16(p) << 16;
+				else if (fileBytes == 3)
+					v = (p[0] << 8) | (p[1] << 16) | (p[2] << 24);
+				else
+					v = get32(p);
+				if (slotBits == 16)
+					tx[slotWord[s]] = (tx[slotWord[s]] & ~(0xFFFFu << slotShift[s])) | (((uint32_t)v >> 16) << slotShift[s]);
+				else
+					tx[slotWord[s]] = v;
+			}
+			tail = (tail + frameBytes) % size;
+		}
+		tx -= n * stride;
+	}
+	used -= n * frameBytes; // in an ISR: service() adds with interrupts off
+	stats.framesPlayed += n;
+
+	if (n < frames) {
+		silence(tx + n * stride, frames - n);
+		if (eof && used < frameBytes) {
+			playing = false; // played to the end
+		} else {
+			stats.underruns++;
+			stats.framesSilent += frames - n;
+			rebuffer = true;
+		}
+	}
+}
+
+void TDMPlayer::getStats(tdmplay_stats &s)
+{
+	__disable_irq();
+	s = stats;
+	__enable_irq();
+}
@@ -0,0 +1,81 @@
+/* Multichannel WAV player feeding the TDM transmit buffer (Teensy 4.X)
+ * loop() reads the file's sample frames in large chunks, at sector aligned file offsets,
+ * into a prefetch ring; the output driver's transmit callback takes them from there
+ * straight into the DMA buffer. No audio blocks or AudioPlaySdWav objects are involved,
+ * and every channel of the file stays in step.
+ *
+ * Direct mode: when the file's frame is the wire frame (as TDM_Recorder writes them) the
+ * callback copies whole frames, swapping 16-bit pairs into slot order.
+ * Mapped mode: otherwise each slot takes a file channel, 16, 24 or 32-bit, by setMap().
+ * On an underrun the player's slots go silent until the ring is half full again.
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef tdm_player_h_
+#define tdm_player_h_
+
+#include <Arduino.h>
+#include <SD.h>
+
+#define TDMPLAY_CHUNK		32768	// bytes per SD read: a multiple of 512
+#define TDMPLAY_MAX_SLOTS	64		// 4 data lines of 16 slots
+#define TDMPLAY_MAX_FRAME	128		// bytes per file frame: 32 channels of 32 bits
+#define TDMPLAY_NONE		(-1)	// setMap(): slot left to the audio graph
+
+typedef struct {
+	uint64_t framesPlayed;
+	uint32_t underruns;		// times the ring ran dry before the end of the file
+	uint32_t framesSilent;	// frames sent as silence because of them
+	uint32_t minFill;		// ring low water mark while playing, bytes
+	uint32_t readMaxUs;		// slowest chunk read
+	uint32_t readErrors;
+} tdmplay_stats;
+
+class TDMPlayer
+{
+public:
+	// ring: a multiple of TDMPLAY_CHUNK bytes in DMAMEM or EXTMEM
+	TDMPlayer(uint8_t *ring, uint32_t bytes);
+	// The transmit buffer: words per frame (the output driver's stride), 16 or 32-bit slots, data lines
+	void setOutput(int words, int slotBits, int lines = 1);
+	// Slot n plays file channel map[n] (TDMPLAY_NONE: left to the audio graph).
+	// No map = slot order. Takes effect at the next play().
+	void setMap(const int8_t *map = nullptr, int count = 0);
+	bool play(const char *name, bool repeat = false);	// PCM WAV or RF64; fills the ring before it starts
+	void stop(void);
+	bool isPlaying(void) { return playing; }
+	bool isDirect(void) { return direct; }
+	int channels(void) { return fileChannels; }
+	uint32_t sampleRate(void) { return fileRate; }
+	void fill(uint32_t *tx, int frames);	// from the transmit callback: ISR
+	bool service(void);		// from loop(): tops up the ring. false on a read error
+	void getStats(tdmplay_stats &stats);
+private:
+	bool parseHeader(void);
+	bool readChunk(void);
+	void silence(uint32_t *tx, int frames);
+	uint8_t *ring;
+	uint32_t size;
+	uint32_t head = 0, tail = 0;	// byte offsets: head written by service(), tail by fill()
+	volatile uint32_t used = 0;
+	volatile bool playing = false;
+	bool rebuffer = false;	// after an underrun: silent until the ring is half full
+	volatile bool eof = false;
+	bool repeat = false, direct = false;
+	// output
+	uint16_t stride = 8, slotBits = 16, lines = 1, slots = 16;
+	int8_t map[TDMPLAY_MAX_SLOTS];
+	int mapCount = 0;
+	int8_t slotChannel[TDMPLAY_MAX_SLOTS];	// for this file
+	uint8_t slotWord[TDMPLAY_MAX_SLOTS], slotShift[TDMPLAY_MAX_SLOTS];
+	// file
+	File file;
+	uint16_t fileChannels = 0, fileBytes = 2, frameBytes = 0;
+	uint32_t fileRate = 0;
+	uint64_t dataStart = 0, dataSize = 0, dataLeft = 0;
+	tdmplay_stats stats = {};
+};
+
+#endif
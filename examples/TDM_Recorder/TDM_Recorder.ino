@@ -0,0 +1,110 @@
+/*
+ * TLV320AIC3104 TDM board multi-codec
+ * Multichannel recorder: every input to one WAV file on the built-in SD card
+ *
+ * The frames are taken straight from the TDM receive buffer by the input driver's receive tap,
+ * so recording needs no audio blocks, connections or record queues.
+ * Serial commands: r = record to a new file, s = stop, p = print the counters
+ * DMA deinterleave (TDM_A_DMA_DEINTERLEAVE) must be off: the tap sees the interleaved buffer.
+ * Uses TDMA Revised library
+ */
+
+#include "output_tdmA.h"
+#include "input_tdmA.h"
+#include <Audio.h>
+#include <Wire.h>
+#include <SD.h>
+#include "control_tlv320aic3104.h"
+#include "tdm_recorder.h"
+
+#define CODECS 8
+#define AUDIO_BLOCKS 4
+#define RST_PIN 22
+
+// 16 channels of 16-bit samples at 44.1kHz are 1.4MB/S: the ring rides out SD write stalls.
+// With PSRAM fitted (Teensy 4.1) define RING_IN_PSRAM for a much longer buffer.
+//#define RING_IN_PSRAM
+#if defined(RING_IN_PSRAM)
+#define RING_BYTES (4 * 1024 * 1024)
+EXTMEM uint8_t ring[RING_BYTES];
+#else
+#define RING_BYTES (256 * 1024)
+DMAMEM uint8_t ring[RING_BYTES];
+#endif
+
+AudioInputTDM_A          tdm_in;
+AudioOutputTDM_A         tdm_out;
+
+AudioControlTLV320AIC3104 aic(CODECS, true, AICMODE_TDM);
+TDMRecorder recorder(ring, RING_BYTES);
+
+int take = 0;
+
+// Runs in the receive ISR
+void capture(const uint32_t *rx, int frames)
+{
+  recorder.capture(rx, frames);
+}
+
+void printStats(void)
+{
+  tdmrec_stats s;
+  recorder.getStats(s);
+  Serial.printf("%.1f S recorded, overruns %lu (%lu frames lost), ring max %lu%%, slowest write %lu uS, errors %lu\n",
+    (float)s.framesRecorded / AUDIO_SAMPLE_RATE_EXACT, s.overruns, s.framesDropped,
+    s.maxFill * 100 / RING_BYTES, s.writeMaxUs, s.writeErrors);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  while (!Serial && millis() < 3000) ;
+  AudioMemory(AUDIO_BLOCKS);
+  Serial.println("\n\nTDM multichannel recorder");
+
+  if (!SD.begin(BUILTIN_SDCARD))
+    Serial.println("No SD card");
+
+  Wire.begin();
+  aic.setVerbose(0);
+  int boardsFound = aic.begin(RST_PIN);
+  Serial.printf("Boards found %i\n", boardsFound);
+  aic.inputMode(AIC_DIFF);
+  if (!aic.enable())
+    Serial.println("Failed to init codecs");
+  aic.inputLevel(0, CH_BOTH, AIC_ALL_CODECS);
+
+  // one word per two 16-bit slots; 32-bit words carry one sample each
+  recorder.setFormat(AudioInputTDM_A::stride, (TDM_A_WORD_BITS == 16) ? 16 : 32, AUDIO_SAMPLE_RATE_EXACT, TDM_A_WORD_BITS);
+  tdm_in.setRxCallback(capture);
+  Serial.printf("%i channels. r = record, s = stop, p = counters\n", AudioInputTDM_A::channels);
+}
+
+uint32_t statsTimer;
+void loop()
+{
+  if (!recorder.service())
+    Serial.println("SD write failed: recording stopped");
+
+  if (Serial.available()) {
+    char c = Serial.read();
+    if (c == 'r' && !recorder.recording()) {
+      char name[16];
+      sprintf(name, "TDM_%03i.WAV", ++take);
+      if (recorder.start(name))
+        Serial.printf("Recording %s\n", name);
+      else
+        Serial.println("Could not open the file");
+    } else if (c == 's' && recorder.recording()) {
+      recorder.stop();
+      printStats();
+    } else if (c == 'p') {
+      printStats();
+    }
+  }
+
+  if (recorder.recording() && millis() - statsTimer > 5000) {
+    statsTimer = millis();
+    printStats();
+  }
+}
@@ -0,0 +1,170 @@
+/* Multichannel SD recorder fed from the TDM receive buffer (Teensy 4.X)
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#include <Arduino.h>
+#include "tdm_recorder.h"
+
+TDMRecorder::TDMRecorder(uint8_t *ringBuffer, uint32_t bytes)
+{
+	ring = ringBuffer;
+	size = bytes - bytes % TDMREC_CHUNK;
+}
+
+void TDMRecorder::setFormat(int words, int bits, uint32_t sampleRate, int valid)
+{
+	frameWords = words;
+	sampleBits = (bits == 16) ? 16 : 32;
+	validBits = (valid > 0 && valid <= sampleBits) ? valid : sampleBits;
+	rate = sampleRate;
+}
+
+bool TDMRecorder::start(const char *name)
+{
+	if (armed || size == 0) return false;
+	SD.remove(name);
+	file = SD.open(name, FILE_WRITE_BEGIN);
+	if (!file) return false;
+	dataBytes = 0;
+	head = tail = 0;
+	used = 0;
+	stats = {};
+	writeHeader(); // placeholder sizes until stop()
+	armed = true;
+	return true;
+}
+
+// Runs in the receive ISR: one copy of the half buffer, or none at all if it does not fit
+void TDMRecorder::capture(const uint32_t *rx, int frames)
+{
+	uint32_t bytes = frames * frameWords * 4;
+	uint32_t n, *dest;
+
+	if (!armed || rx == nullptr) return;
+	if (used + bytes > size) {
+		stats.overruns++;
+		stats.framesDropped += frames;
+		return;
+	}
+	while (bytes) {
+		n = min(bytes, size - head);	// up to the end of the ring
+		dest = (uint32_t *)(ring + head);
+		if (sampleBits == 16) {
+			for (uint32_t i = 0; i < n / 4; i++) {
+				uint32_t w = *rx++;
+				dest[i] = (w >> 16) | (w << 16);	// first slot to the lower address
+			}
+		} else {
+			memcpy(dest, rx, n);
+			rx += n / 4;
+		}
+		head = (head + n) % size;
+		used += n;
+		bytes -= n;
+	}
+	if (used > stats.maxFill) stats.maxFill = used;
+	stats.framesRecorded += frames;
+}
+
+bool TDMRecorder::writeChunk(uint32_t bytes)
+{
+	uint32_t t = micros();
+	uint32_t n = min(bytes, size - tail);
+	bool ok = (file.write(ring + tail, n) == n);
+
+	if (ok && n < bytes) // the last, partial chunk may wrap
+		ok = (file.write(ring, bytes - n) == bytes - n);
+	t = micros() - t;
+	if (t > stats.writeMaxUs) stats.writeMaxUs = t;
+	if (!ok) {
+		stats.writeErrors++;
+		return false;
+	}
+	tail = (tail + bytes) % size;
+	__disable_irq();
+	used -= bytes;
+	__enable_irq();
+	dataBytes += bytes;
+	return true;
+}
+
+// Whole chunks only: tail stays chunk aligned, and so does the file offset
+bool TDMRecorder::service(void)
+{
+	if (!file) return true;
+	while (used >= TDMREC_CHUNK) {
+		if (!writeChunk(TDMREC_CHUNK)) {
+			stop();
+			return false;
+		}
+	}
+	return true;
+}
+
+void TDMRecorder::stop(void)
+{
+	if (!file) return;
+	armed = false;
+	while (used >= TDMREC_CHUNK && writeChunk(TDMREC_CHUNK)) ;
+	if (used && stats.writeErrors == 0) writeChunk(used);
+	writeHeader();
+	file.close();
+}
+
+void TDMRecorder::getStats(tdmrec_stats &s)
+{
+	__disable_irq();
+	s = stats;
+	__enable_irq();
+}
+
+static void put16(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static void put32(uint8_t *p, uint32_t v) { put16(p, v); put16(p + 2, v >> 16); }
+static void put64(uint8_t *p, uint64_t v) { put32(p, v); put32(p + 4, v >> 32); }
+
+// RIFF, a JUNK chunk that becomes ds64 for RF64, WAVE_FORMAT_EXTENSIBLE fmt,
+// JUNK padding, then data at TDMREC_HEADER
+void TDMRecorder::writeHeader(void)
+{
+	static const uint8_t pcm_guid[16] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+		0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+	uint8_t h[TDMREC_HEADER];
+	uint16_t channels = frameWords * 32 / sampleBits;
+	uint16_t align = frameWords * 4;
+	uint64_t riff = dataBytes + TDMREC_HEADER - 8;
+	bool rf64 = (riff > 0xFFFFFFFF);
+
+	memset(h, 0, sizeof(h));
+	memcpy(h, rf64 ? "RF64" : "RIFF", 4);
+	put32(h + 4, rf64 ? 0xFFFFFFFF : riff);
+	memcpy(h + 8, "WAVE", 4);
+	memcpy(h + 12, rf64 ? "ds64" : "JUNK", 4);
+	put32(h + 16, 28);
+	if (rf64) {
+		put64(h + 20, riff);
+		put64(h + 28, dataBytes);
+		put64(h + 36, dataBytes / align);
+	}
+	memcpy(h + 48, "fmt ", 4);
+	put32(h + 52, 40);
+	put16(h + 56, 0xFFFE);	// WAVE_FORMAT_EXTENSIBLE: more than two channels
+	put16(h + 58, channels);
+	put32(h + 60, rate);
+	put32(h + 64, rate * align);
+	put16(h + 68, align);
+	put16(h + 70, sampleBits);
+	put16(h + 72, 22);
+	put16(h + 74, validBits);
+	put32(h + 76, 0);		// no speaker positions
+	memcpy(h + 80, pcm_guid, 16);
+	memcpy(h + 96, "JUNK", 4);
+	put32(h + 100, TDMREC_HEADER - 96 - 16);
+	memcpy(h + TDMREC_HEADER - 8, "data", 4);
+	put32(h + TDMREC_HEADER - 4, rf64 ? 0xFFFFFFFF : dataBytes);
+
+	file.seek(0);
+	file.write(h, sizeof(h));
+	file.seek(TDMREC_HEADER + dataBytes);
+}
@@ -0,0 +1,60 @@
+/* Multichannel SD recorder fed from the TDM receive buffer (Teensy 4.X)
+ * The input driver's receive tap hands over each half buffer as it arrives. Interleaved
+ * TDM frames already have the layout of a WAV file's sample frames, so they are copied once,
+ * into a ring buffer, and written from loop() in whole chunks at sector aligned file offsets.
+ * 16-bit slots come two to a word with the first slot in the upper half: those words are
+ * swapped on the way in. 32-bit words (TDM_32, TDM_B, TDM_A at 24/32 bits) go in as they are.
+ * Files over 4GB are closed as RF64.
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef tdm_recorder_h_
+#define tdm_recorder_h_
+
+#include <Arduino.h>
+#include <SD.h>
+
+#define TDMREC_CHUNK	32768	// bytes per SD write: a multiple of 512
+#define TDMREC_HEADER	512		// WAV header, padded so the samples start on a sector
+
+typedef struct {
+	uint64_t framesRecorded;	// frames in the ring or on the card
+	uint32_t framesDropped;		// frames lost because the ring was full
+	uint32_t overruns;			// DMA periods lost
+	uint32_t maxFill;			// ring high water mark, bytes
+	uint32_t writeMaxUs;		// slowest chunk write
+	uint32_t writeErrors;
+} tdmrec_stats;
+
+class TDMRecorder
+{
+public:
+	// ring: a multiple of TDMREC_CHUNK bytes in DMAMEM or EXTMEM
+	TDMRecorder(uint8_t *ring, uint32_t bytes);
+	// words: 32-bit words per frame (the input driver's stride); bits: 16 or 32 per sample;
+	// validBits: CODEC word length in a 32-bit sample, 0 = bits
+	void setFormat(int words, int bits, uint32_t sampleRate, int validBits = 0);
+	bool start(const char *name);	// new file; capture starts with the next DMA period
+	void stop(void);				// writes the rest and completes the header
+	bool recording(void) { return armed; }
+	void capture(const uint32_t *rx, int frames);	// from the receive tap: ISR
+	bool service(void);				// from loop(): writes the whole chunks waiting. false on a write error
+	void getStats(tdmrec_stats &stats);
+private:
+	bool writeChunk(uint32_t bytes);
+	void writeHeader(void);
+	uint8_t *ring;
+	uint32_t size;
+	uint32_t head = 0, tail = 0;	// byte offsets: head written by capture(), tail by service()
+	volatile uint32_t used = 0;
+	volatile bool armed = false;
+	uint16_t frameWords = 8, sampleBits = 16, validBits = 16;
+	uint32_t rate = 44100;
+	uint64_t dataBytes = 0;	// on the card
+	File file;
+	tdmrec_stats stats = {};
+};
+
+#endif
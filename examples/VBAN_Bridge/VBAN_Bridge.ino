@@ -0,0 +1,99 @@
+/*
+ * TLV320AIC3104 TDM board multi-codec
+ * VBAN network bridge: all 16 TDM inputs out as one VBAN stream, one 16 channel VBAN stream in to the 16 outputs
+ *
+ * Frames are taken from the TDM receive tap and put into the transmit callback, so the audio graph
+ * is not involved. Each packet carries 44 frames of all 16 channels (one 1464 byte datagram).
+ * Received packets go through a jitter buffer that adapts its depth, and a resampler that follows
+ * the sender's clock. Run two Teensys with each other's PEER_IP, or one against Voicemeeter
+ * (16 channels, 16-bit PCM, matching stream name and sample rate).
+ * Use a wired, preferably audio-only, network.
+ * Teensy 4.1, QNEthernet library. Uses TDMA Revised library
+ */
+
+#include "output_tdmA.h"
+#include "input_tdmA.h"
+#include <Audio.h>
+#include <Wire.h>
+#include <QNEthernet.h>
+#include "control_tlv320aic3104.h"
+#include "vban_bridge.h"
+
+#if TDM_A_WORD_BITS != 16 || TDM_A_TX_LINES != 1 || TDM_A_RX_LINES != 1 || defined(TDM_A_DMA_DEINTERLEAVE)
+#error "The bridge uses one data line of 16-bit slots each way, without DMA deinterleave"
+#endif
+
+using namespace qindesign::network;
+
+#define CODECS 8
+#define CHANNELS (CODECS * 2)
+#define AUDIO_BLOCKS 4
+#define RST_PIN 22
+#define STREAM "Stream1"
+IPAddress PEER_IP(192, 168, 1, 51);
+
+AudioInputTDM_A          tdm_in;
+AudioOutputTDM_A         tdm_out;
+
+AudioControlTLV320AIC3104 aic(CODECS, true, AICMODE_TDM);
+EthernetUDP udp;
+VBANTransportUDP transport(udp, PEER_IP, VBAN_PORT);
+VBANBridge bridge(transport, STREAM, CHANNELS, 44100);
+
+// Run in the receive and transmit ISRs
+void sendFrames(const uint32_t *rx, int frames)
+{
+  bridge.writeTDM(rx, frames);
+}
+
+void playFrames(const uint32_t *rx, uint32_t *tx, int frames)
+{
+  bridge.readTDM(tx, frames);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  while (!Serial && millis() < 3000) ;
+  AudioMemory(AUDIO_BLOCKS);
+  Serial.println("\n\nTDM VBAN bridge");
+
+  Ethernet.setHostname("Teensy1");
+  if (!Ethernet.begin() || !Ethernet.waitForLocalIP(10000))
+    Serial.println("No IP address");
+  else
+    Serial.println(Ethernet.localIP());
+  udp.begin(VBAN_PORT);
+
+  Wire.begin();
+  aic.setVerbose(0);
+  int boardsFound = aic.begin(RST_PIN);
+  Serial.printf("Boards found %i\n", boardsFound);
+  aic.inputMode(AIC_DIFF);
+  if (!aic.enable())
+    Serial.println("Failed to init codecs");
+  aic.volume(0.8, CH_BOTH, AIC_ALL_CODECS);
+  aic.inputLevel(0, CH_BOTH, AIC_ALL_CODECS);
+
+  if (!bridge.ok())
+    Serial.println("Sample rate not in the VBAN list");
+  tdm_in.setRxCallback(sendFrames);
+  tdm_out.setCallback(playFrames);
+  Serial.printf("%i channels, %i frames per packet\n", CHANNELS, bridge.framesPerPacket());
+}
+
+uint32_t statsTimer;
+void loop()
+{
+  bridge.poll();
+
+  if (millis() - statsTimer > 5000) {
+    statsTimer = millis();
+    vban_stats s;
+    bridge.getStats(s);
+    Serial.printf("sent %lu, received %lu, lost %lu, late %lu, rejected %lu, underruns %lu, overflows %lu | ",
+      s.packetsSent, s.packetsReceived, s.lost, s.late, s.rejected, s.underruns, s.overflows);
+    Serial.printf("depth %lu (target %lu, %lu-%lu) frames, rate %+.1f ppm\n",
+      s.depth, s.depthTarget, s.depthMin, s.depthMax, s.ratePPM);
+  }
+}
@@ -0,0 +1,123 @@
+/* Loopback test for the VBAN bridge on a PC
+ * Two bridges talk over UDP on 127.0.0.1, one as sender and one as receiver, with no TDM hardware:
+ * the sender's clock runs off by a set ppm and packets can be dropped on the way.
+ * Each scenario settles, then checks the receiver's statistics and prints them.
+ *
+ * Build and run from this folder (Linux, macOS):
+ *   g++ -O2 -Wall -Wextra -I.. vban_loopback.cpp ../vban_bridge.cpp -o vban_loopback && ./vban_loopback
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "vban_bridge.h"
+
+#define CHANNELS	16
+#define RATE		44100
+#define BLOCK		128		// receiver frames per read(), as the TDM callback
+#define SETTLE		20		// S before the stats are reset and measured
+#define MEASURE		40		// S measured
+#define PORT_A		16980
+#define PORT_B		16981
+
+// A UDP transport that drops every dropEvery'th packet sent
+class LossyTransport : public VBANTransport
+{
+public:
+	LossyTransport(uint16_t localPort, uint16_t destPort, int dropEvery)
+		: udp(localPort, "127.0.0.1", destPort), every(dropEvery) {}
+	bool ok(void) { return udp.ok(); }
+	bool send(const uint8_t *data, int len) {
+		if (every && ++count % every == 0) {
+			dropped++;
+			return true;
+		}
+		return udp.send(data, len);
+	}
+	int receive(uint8_t *data, int max) { return udp.receive(data, max); }
+	uint32_t dropped = 0;
+private:
+	VBANTransportPOSIX udp;
+	int every;
+	uint32_t count = 0;
+};
+
+static void print(const vban_stats &s)
+{
+	printf("  receiver: received %u, lost %u, late %u, rejected %u, resyncs %u, underruns %u, overflows %u\n",
+		s.packetsReceived, s.lost, s.late, s.rejected, s.resyncs, s.underruns, s.overflows);
+	printf("            depth %u (target %u, %u-%u) frames, rate %+.1f ppm\n",
+		s.depth, s.depthTarget, s.depthMin, s.depthMax, s.ratePPM);
+}
+
+// The sender writes (1 + ppm * 1e-6) frames for each frame the receiver reads.
+// Returns true if the receiver followed the drift without underruns and counted every drop as lost.
+static bool scenario(const char *name, double ppm, int dropEvery)
+{
+	static int16_t in[2 * BLOCK * CHANNELS], out[BLOCK * CHANNELS];
+	LossyTransport ta(PORT_A, PORT_B, dropEvery), tb(PORT_B, PORT_A, 0);
+	VBANBridge *tx = new VBANBridge(ta, "Loop", CHANNELS, RATE);
+	VBANBridge *rx = new VBANBridge(tb, "Loop", CHANNELS, RATE);
+	double acc = 0, phase = 0;
+	uint32_t droppedAtReset = 0;
+	vban_stats s, t;
+	bool pass;
+
+	printf("%s: sender %+.0f ppm, %s\n", name, ppm, dropEvery ? "packet loss" : "no loss");
+	if (!ta.ok() || !tb.ok()) {
+		printf("  no UDP sockets on ports %i, %i\n", PORT_A, PORT_B);
+		return false;
+	}
+	for (long block = 0; block < (long)(SETTLE + MEASURE) * RATE / BLOCK; block++) {
+		if (block == (long)SETTLE * RATE / BLOCK) {
+			rx->resetStats();
+			tx->resetStats();
+			droppedAtReset = ta.dropped;
+		}
+		acc += BLOCK * (1.0 + ppm * 1e-6);
+		int n = (int)acc;
+		acc -= n;
+		for (int f = 0; f < n; f++, phase += 0.0627) {
+			for (int c = 0; c < CHANNELS; c++)
+				in[f * CHANNELS + c] = (int16_t)(8000 * sin(phase * (c + 1)));
+		}
+		tx->write(in, n);
+		tx->poll();
+		rx->poll();
+		rx->read(out, BLOCK);
+	}
+	rx->getStats(s);
+	tx->getStats(t);
+	print(s);
+	printf("  sender: sent %u, txOverruns %u\n", t.packetsSent, t.txOverruns);
+	// a dropped packet still in flight at the end may not have been counted yet
+	pass = s.underruns == 0 && s.overflows == 0 && s.late == 0 && s.rejected == 0
+		&& fabs(s.ratePPM - ppm) < 30 && s.lost + 1 >= ta.dropped - droppedAtReset && s.lost <= ta.dropped - droppedAtReset;
+	printf("  dropped %u: %s\n\n", ta.dropped - droppedAtReset, pass ? "pass" : "FAIL");
+	delete tx;
+	delete rx;
+	return pass;
+}
+
+int main()
+{
+	int failed = 0;
+
+	{
+		VBANTransportPOSIX t(PORT_A, "127.0.0.1", PORT_B);
+		VBANBridge bad(t, "Loop", CHANNELS, 44000);
+		printf("%i channels, %i frames per packet\n\n", CHANNELS, bad.framesPerPacket());
+		if (bad.ok()) {
+			printf("44000: not a VBAN rate, but accepted: FAIL\n\n");
+			failed++;
+		}
+	}
+	failed += !scenario("Clocks matched", 0, 0);
+	failed += !scenario("Sender fast", 100, 0);
+	failed += !scenario("Sender slow", -300, 0);
+	failed += !scenario("1% packet loss", 50, 100);
+	printf("%s\n", failed ? "FAILED" : "all passed");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,303 @@
+/* Multichannel VBAN bridge for the TDM drivers
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#include <string.h>
+#include "vban_bridge.h"
+
+// VBAN header byte 4: sample rate index (low 5 bits), sub protocol (top 3 bits, 0 = audio)
+static const uint32_t vban_rates[] = {6000, 12000, 24000, 48000, 96000, 192000, 384000,
+	8000, 16000, 32000, 64000, 128000, 256000, 512000,
+	11025, 22050, 44100, 88200, 176400, 352800, 705600};
+#define VBAN_RATES		(sizeof(vban_rates) / sizeof(vban_rates[0]))
+#define VBAN_INT16		1	// header byte 7: data type, PCM codec
+
+#define TDM_CHUNK		32	// readTDM(): frames per read()
+#define TX_MASK			(VBAN_TX_FRAMES - 1)
+#define JB_MASK			(VBAN_JB_FRAMES - 1)
+
+// Rate trim: P on the smoothed fill error (time constant ~2 S at 44.1kHz), I to remove the offset
+#define TRIM_P			1e-5f	// per frame of error
+#define TRIM_I			1e-6f	// per frame of error, per second
+#define FILL_SMOOTH		0.1f	// S
+
+VBANBridge::VBANBridge(VBANTransport &transport, const char *streamName, int chans, uint32_t rate) : net(transport)
+{
+	memset(name, 0, sizeof(name)); // not terminated at full length, as on the wire
+	for (int i = 0; i < VBAN_STREAM_NAME && streamName[i]; i++)
+		name[i] = streamName[i];
+	channels = (chans < 1) ? 1 : (chans > VBAN_MAX_CHANNELS) ? VBAN_MAX_CHANNELS : chans;
+	sampleRate = rate;
+	rateIndex = -1; // not a VBAN rate: ok() is false and poll() does nothing
+	for (unsigned int i = 0; i < VBAN_RATES; i++) {
+		if (vban_rates[i] == rate)
+			rateIndex = i;
+	}
+	txPacketFrames = VBAN_DATA_MAX / (channels * 2);
+	if (txPacketFrames > VBAN_FRAMES_MAX)
+		txPacketFrames = VBAN_FRAMES_MAX;
+	rxPacketFrames = txPacketFrames;
+	target = 3 * txPacketFrames;
+	setDepth(2 * txPacketFrames, VBAN_JB_FRAMES / 2);
+	resetStats();
+}
+
+void VBANBridge::setDepth(int minFrames, int maxFrames)
+{
+	limitMax = (maxFrames > VBAN_JB_FRAMES / 2) ? VBAN_JB_FRAMES / 2 : maxFrames;
+	limitMin = (minFrames < 2) ? 2 : ((uint32_t)minFrames > limitMax) ? limitMax : minFrames;
+	target = (target < limitMin) ? limitMin : (target > limitMax) ? limitMax : target;
+}
+
+/********************************* send **********************************/
+
+int VBANBridge::write(const int16_t *frames, int count)
+{
+	uint32_t wr = txWr;
+
+	if (VBAN_TX_FRAMES - (wr - txRd) < (uint32_t)count) {
+		stats.txOverruns += count;
+		return 0;
+	}
+	for (int f = 0; f < count; f++, wr++, frames += channels)
+		memcpy(&txBuf[(wr & TX_MASK) * channels], frames, channels * 2);
+	txWr = wr;
+	return count;
+}
+
+// Two 16-bit slots per word, the first in the upper half
+int VBANBridge::writeTDM(const uint32_t *rx, int count)
+{
+	uint32_t wr = txWr;
+	int16_t *dest;
+
+	if (VBAN_TX_FRAMES - (wr - txRd) < (uint32_t)count) {
+		stats.txOverruns += count;
+		return 0;
+	}
+	for (int f = 0; f < count; f++, wr++, rx += VBAN_TDM_WORDS) {
+		dest = &txBuf[(wr & TX_MASK) * channels];
+		for (int c = 0; c < channels; c++)
+			dest[c] = (c & 1) ? (int16_t)rx[c >> 1] : (int16_t)(rx[c >> 1] >> 16);
+	}
+	txWr = wr;
+	return count;
+}
+
+/******************************** receive ********************************/
+
+void VBANBridge::receivePacket(const uint8_t *buf, int len)
+{
+	uint32_t counter, gap, fill, wr;
+	int frames, bytes, first;
+
+	if (len < VBAN_HEADER || memcmp(buf, "VBAN", 4) || (buf[4] & 0xE0) != 0 || (buf[4] & 0x1F) != rateIndex
+		|| buf[7] != VBAN_INT16 || buf[6] + 1 != channels || strncmp((const char *)buf + 8, name, VBAN_STREAM_NAME)) {
+		stats.rejected++;
+		return;
+	}
+	frames = buf[5] + 1;
+	bytes = frames * channels * 2;
+	if (len != VBAN_HEADER + bytes) {
+		stats.rejected++;
+		return;
+	}
+	counter = buf[24] | (buf[25] << 8) | (buf[26] << 16) | ((uint32_t)buf[27] << 24);
+	stats.packetsReceived++;
+
+	gap = counter - rxNext;
+	if (!rxStarted || (gap > VBAN_RESYNC && -gap > VBAN_RESYNC)) {
+		if (rxStarted) stats.resyncs++;
+		resync();
+		rxStarted = true;
+		gap = 0;
+	} else if (gap > VBAN_RESYNC) { // behind the expected counter: late or repeated
+		stats.late++;
+		return;
+	}
+	rxNext = counter + 1;
+	rxPacketFrames = frames;
+
+	wr = jbWr;
+	fill = wr - jbRd;
+	if (gap) {
+		// lost packets: silence in their place keeps the stream in time
+		stats.lost += gap;
+		for (uint32_t i = 0; i < gap * frames && fill < VBAN_JB_FRAMES - (uint32_t)frames; i++, wr++, fill++)
+			memset(&jb[(wr & JB_MASK) * channels], 0, channels * 2);
+	}
+	if (fill + frames > VBAN_JB_FRAMES) {
+		stats.overflows++;
+		jbWr = wr;
+		return;
+	}
+	// little endian int16 frames, as held here: copy, split at the end of the buffer
+	first = VBAN_JB_FRAMES - (wr & JB_MASK);
+	if (first > frames) first = frames;
+	memcpy(&jb[(wr & JB_MASK) * channels], buf + VBAN_HEADER, first * channels * 2);
+	memcpy(jb, buf + VBAN_HEADER + first * channels * 2, (frames - first) * channels * 2);
+	jbWr = wr + frames;
+}
+
+// A new or restarted stream: read() starts again from here once it has filled
+void VBANBridge::resync(void)
+{
+	flushTo = jbWr;
+	flush = true;
+}
+
+void VBANBridge::poll(void)
+{
+	uint8_t buf[VBAN_HEADER + VBAN_DATA_MAX];
+	uint32_t rd;
+	int n, first;
+
+	if (!ok()) return;
+	// send
+	while (txWr - txRd >= (uint32_t)txPacketFrames) {
+		rd = txRd;
+		memcpy(buf, "VBAN", 4);
+		buf[4] = rateIndex;
+		buf[5] = txPacketFrames - 1;
+		buf[6] = channels - 1;
+		buf[7] = VBAN_INT16;
+		memcpy(buf + 8, name, VBAN_STREAM_NAME);
+		buf[24] = txCounter;
+		buf[25] = txCounter >> 8;
+		buf[26] = txCounter >> 16;
+		buf[27] = txCounter >> 24;
+		first = VBAN_TX_FRAMES - (rd & TX_MASK);
+		if (first > txPacketFrames) first = txPacketFrames;
+		memcpy(buf + VBAN_HEADER, &txBuf[(rd & TX_MASK) * channels], first * channels * 2);
+		memcpy(buf + VBAN_HEADER + first * channels * 2, txBuf, (txPacketFrames - first) * channels * 2);
+		txRd = rd + txPacketFrames;
+		txCounter++;
+		if (net.send(buf, VBAN_HEADER + txPacketFrames * channels * 2))
+			stats.packetsSent++;
+	}
+	// receive
+	while ((n = net.receive(buf, sizeof(buf))) > 0)
+		receivePacket(buf, n);
+}
+
+/******************************** playout ********************************/
+
+// Hold the smoothed fill at the target depth by trimming the resampling ratio,
+// and move the target with the jitter seen over each second
+void VBANBridge::trimRate(uint32_t fill, int count)
+{
+	float err, alpha = count / (sampleRate * FILL_SMOOTH);
+
+	fillAvg += (fill - fillAvg) * ((alpha > 1.0f) ? 1.0f : alpha);
+	err = fillAvg - target;
+	// the integral learns the clock drift: only near the target, so jitter bursts and refills don't wind it up
+	if (err < rxPacketFrames && err > -rxPacketFrames)
+		integral += err * TRIM_I * count / sampleRate;
+	if (integral > VBAN_MAX_PPM * 1e-6f) integral = VBAN_MAX_PPM * 1e-6f;
+	if (integral < -VBAN_MAX_PPM * 1e-6f) integral = -VBAN_MAX_PPM * 1e-6f;
+	ratio = 1.0f + TRIM_P * err + integral;
+	if (ratio > 1.0f + VBAN_MAX_PPM * 1e-6f) ratio = 1.0f + VBAN_MAX_PPM * 1e-6f;
+	if (ratio < 1.0f - VBAN_MAX_PPM * 1e-6f) ratio = 1.0f - VBAN_MAX_PPM * 1e-6f;
+
+	if (fill < windowMin) windowMin = fill;
+	windowFrames += count;
+	if (windowFrames >= sampleRate) {
+		// once settled, the lowest fill is the margin the jitter left: shrink towards one packet of it
+		if (windowMin > 2 * (uint32_t)rxPacketFrames && err < rxPacketFrames && err > -rxPacketFrames) {
+			uint32_t shrink = (windowMin - rxPacketFrames) / 16;
+			target = (target > limitMin + shrink) ? target - shrink : limitMin;
+		}
+		windowFrames = 0;
+		windowMin = VBAN_JB_FRAMES;
+	}
+}
+
+void VBANBridge::read(int16_t *out, int count)
+{
+	const int16_t *a, *b;
+	uint32_t rd = jbRd, fill;
+	int f = 0, c;
+
+	if (flush) {
+		rd = flushTo;
+		flush = false;
+		playing = false;
+	}
+	// depth is measured after each read, at its lowest
+	fill = jbWr - rd;
+	if (!playing && fill >= target + count) {
+		playing = true;
+		phase = 0;
+		fillAvg = fill - count;
+		windowFrames = 0;
+		windowMin = VBAN_JB_FRAMES;
+	}
+	if (playing) {
+		for (; f < count; f++, out += channels) {
+			if (jbWr - rd < 2) { // ran dry: wait for the target depth again, and make it deeper
+				playing = false;
+				stats.underruns++;
+				target += 2 * rxPacketFrames;
+				if (target > limitMax) target = limitMax;
+				break;
+			}
+			// linear interpolation between frames rd and rd + 1
+			a = &jb[(rd & JB_MASK) * channels];
+			b = &jb[((rd + 1) & JB_MASK) * channels];
+			for (c = 0; c < channels; c++)
+				out[c] = a[c] + (int32_t)((b[c] - a[c]) * phase);
+			phase += ratio;
+			while (phase >= 1.0f) {
+				phase -= 1.0f;
+				rd++;
+			}
+		}
+		jbRd = rd;
+		fill = jbWr - rd;
+		if (playing) trimRate(fill, count);
+		stats.depth = fill;
+		if (fill < stats.depthMin) stats.depthMin = fill;
+		if (fill > stats.depthMax) stats.depthMax = fill;
+	} else {
+		jbRd = rd;
+	}
+	for (; f < count; f++, out += channels)
+		memset(out, 0, channels * 2);
+	stats.depthTarget = target;
+	stats.ratePPM = (ratio - 1.0f) * 1e6f;
+}
+
+void VBANBridge::readTDM(uint32_t *tx, int count)
+{
+	int16_t frames[TDM_CHUNK * VBAN_MAX_CHANNELS];
+	uint32_t *w;
+	int n, f, c;
+
+	for (; count > 0; count -= n) {
+		n = (count > TDM_CHUNK) ? TDM_CHUNK : count;
+		read(frames, n);
+		for (f = 0; f < n; f++, tx += VBAN_TDM_WORDS) {
+			for (c = 0; c < channels; c++) {
+				w = &tx[c >> 1];
+				if (c & 1)
+					*w = (*w & 0xFFFF0000) | (uint16_t)frames[f * channels + c];
+				else
+					*w = (*w & 0x0000FFFF) | ((uint32_t)(uint16_t)frames[f * channels + c] << 16);
+			}
+		}
+	}
+}
+
+void VBANBridge::getStats(vban_stats &s)
+{
+	s = stats;
+}
+
+void VBANBridge::resetStats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+	stats.depthMin = VBAN_JB_FRAMES;
+	stats.depthTarget = target;
+}
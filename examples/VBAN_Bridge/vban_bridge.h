@@ -0,0 +1,96 @@
+/* Multichannel VBAN bridge for the TDM drivers
+ * Send: all channels of each TDM frame go into one stream, batched into VBAN packets
+ * as large as the MTU allows (44 frames of 16 channels), rather than one stream per channel.
+ * Receive: packets go into a jitter buffer whose depth adapts to the arrival jitter seen;
+ * a fractional resampler plays it out at the local SAI clock, its rate trimmed to hold
+ * the buffer at that depth, so sender/receiver clock drift never under- or overflows it.
+ *
+ * Plain C++ apart from the transport (vban_transport.h), so it also runs on a PC over
+ * loopback UDP. On Teensy, write() and writeTDM() run in the receive tap and read() and
+ * readTDM() in the transmit callback; poll() runs from loop().
+ *
+ * VBAN: https://vb-audio.com/Voicemeeter/vban.htm
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef vban_bridge_h_
+#define vban_bridge_h_
+
+#include <stdint.h>
+#include "vban_transport.h"
+
+#define VBAN_PORT			6980
+#define VBAN_HEADER			28
+#define VBAN_DATA_MAX		1436	// payload bytes: header and payload fit a 1500 byte MTU
+#define VBAN_FRAMES_MAX		256		// per packet
+#define VBAN_STREAM_NAME	16
+#define VBAN_MAX_CHANNELS	16
+#define VBAN_TDM_WORDS		8		// writeTDM(), readTDM(): TDM_A words per frame, one data line
+#define VBAN_TX_FRAMES		1024	// send FIFO, frames: a power of 2
+#define VBAN_JB_FRAMES		2048	// jitter buffer, frames: a power of 2. Depth up to half of it
+#define VBAN_MAX_PPM		1000	// resampler trim limit
+#define VBAN_RESYNC			64		// packets: a bigger jump in the counter restarts the stream
+
+typedef struct {
+	uint32_t packetsSent, packetsReceived;
+	uint32_t lost;			// packets missing from the counter sequence: replaced by silence
+	uint32_t late;			// arrived after a later packet, or twice: dropped
+	uint32_t rejected;		// not VBAN audio, or another stream, format or channel count
+	uint32_t resyncs;		// the stream restarted or jumped
+	uint32_t underruns;		// jitter buffer ran dry: silence until it refills to the target depth
+	uint32_t overflows;		// packets dropped with the jitter buffer full
+	uint32_t txOverruns;	// frames the send FIFO had no room for
+	uint32_t depth, depthTarget, depthMin, depthMax;	// jitter buffer, frames. min/max since resetStats()
+	float ratePPM;			// resampler trim: + plays faster than the local clock
+} vban_stats;
+
+class VBANBridge
+{
+public:
+	// The same channel count both ways; sampleRate must be in the VBAN rate list
+	VBANBridge(VBANTransport &transport, const char *streamName, int channels, uint32_t sampleRate);
+	bool ok(void) { return rateIndex >= 0; }	// false: sampleRate has no VBAN code, nothing is sent or received
+	// Jitter buffer depth limits, frames. Default: two packets to VBAN_JB_FRAMES / 2.
+	void setDepth(int minFrames, int maxFrames);
+	// send: interleaved frames, or TDM_A wire frames (one data line of 16-bit slots)
+	int write(const int16_t *frames, int count);
+	int writeTDM(const uint32_t *rx, int count);
+	// receive: count frames at the local rate; silence while buffering
+	void read(int16_t *frames, int count);
+	void readTDM(uint32_t *tx, int count);	// slots 0..channels-1 only
+	void poll(void);	// sends the full packets waiting, takes in the received ones
+	void getStats(vban_stats &stats);
+	void resetStats(void);
+	int framesPerPacket(void) { return txPacketFrames; }
+private:
+	void receivePacket(const uint8_t *buf, int len);
+	void resync(void);
+	void trimRate(uint32_t fill, int count);
+	VBANTransport &net;
+	char name[VBAN_STREAM_NAME];
+	int8_t rateIndex;
+	int channels, txPacketFrames;
+	uint32_t sampleRate;
+	// send FIFO: wr by write(), rd by poll()
+	int16_t txBuf[VBAN_TX_FRAMES * VBAN_MAX_CHANNELS];
+	volatile uint32_t txWr = 0, txRd = 0;
+	uint32_t txCounter = 0;
+	// jitter buffer: wr by poll(), rd by read()
+	int16_t jb[VBAN_JB_FRAMES * VBAN_MAX_CHANNELS];
+	volatile uint32_t jbWr = 0, jbRd = 0;
+	volatile bool flush = false;	// poll() asks read() to restart the buffer at flushTo
+	volatile uint32_t flushTo = 0;
+	uint32_t rxNext = 0;	// expected packet counter
+	bool rxStarted = false;
+	int rxPacketFrames;
+	// playout, owned by read()
+	bool playing = false;
+	float phase = 0, ratio = 1, fillAvg = 0, integral = 0;
+	uint32_t limitMin, limitMax, target;	// depth, frames
+	uint32_t windowFrames = 0, windowMin = 0;	// lowest fill over the last second
+	vban_stats stats;
+};
+
+#endif
@@ -0,0 +1,90 @@
+/* Datagram transport for the VBAN bridge
+ * VBANBridge sends and receives whole VBAN packets through this interface only.
+ * VBANTransportUDP: any Arduino UDP object, e.g. QNEthernet's EthernetUDP on a Teensy 4.1.
+ * VBANTransportPOSIX: a BSD socket, to run the bridge on a PC (loopback tests, or against Voicemeeter).
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef vban_transport_h_
+#define vban_transport_h_
+
+#include <stdint.h>
+
+class VBANTransport
+{
+public:
+	virtual ~VBANTransport() {}
+	virtual bool send(const uint8_t *data, int len) = 0;
+	// One waiting datagram into data: its length, or 0 if there is none. Must not block.
+	virtual int receive(uint8_t *data, int max) = 0;
+};
+
+#if defined(ARDUINO)
+#include <Udp.h>
+#include <IPAddress.h>
+
+// udp must already be listening: udp.begin(VBAN_PORT)
+class VBANTransportUDP : public VBANTransport
+{
+public:
+	VBANTransportUDP(UDP &udp, IPAddress dest, uint16_t port) : udp(udp), dest(dest), port(port) {}
+	bool send(const uint8_t *data, int len) {
+		return udp.beginPacket(dest, port) && udp.write(data, len) == (size_t)len && udp.endPacket();
+	}
+	int receive(uint8_t *data, int max) {
+		int n = udp.parsePacket();
+		return (n > 0 && n <= max) ? udp.read(data, n) : 0;
+	}
+private:
+	UDP &udp;
+	IPAddress dest;
+	uint16_t port;
+};
+
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+class VBANTransportPOSIX : public VBANTransport
+{
+public:
+	// Listens on localPort, sends to destIP:destPort
+	VBANTransportPOSIX(uint16_t localPort, const char *destIP, uint16_t destPort) {
+		struct sockaddr_in local;
+		memset(&local, 0, sizeof(local));
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl(INADDR_ANY);
+		local.sin_port = htons(localPort);
+		memset(&dest, 0, sizeof(dest));
+		dest.sin_family = AF_INET;
+		dest.sin_port = htons(destPort);
+		inet_pton(AF_INET, destIP, &dest.sin_addr);
+		fd = socket(AF_INET, SOCK_DGRAM, 0);
+		if (fd >= 0 && (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0
+			|| fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	~VBANTransportPOSIX() { if (fd >= 0) close(fd); }
+	bool ok(void) { return fd >= 0; }
+	bool send(const uint8_t *data, int len) {
+		return fd >= 0 && sendto(fd, data, len, 0, (struct sockaddr *)&dest, sizeof(dest)) == len;
+	}
+	int receive(uint8_t *data, int max) {
+		int n = (fd >= 0) ? recv(fd, data, max, 0) : -1;
+		return (n > 0) ? n : 0;
+	}
+private:
+	int fd;
+	struct sockaddr_in dest;
+};
+#endif
+
+#endif
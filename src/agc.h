@@ -5,6 +5,7 @@
 // automatically enabled. May be enabled/disabled using AGCenable()
 bool AudioControlTLV320AIC3104::AGC(int8_t targetLevel, int8_t attack, int8_t decay, float maxGain,  uint8_t hysteresis,  float noiseThresh, bool clipStep, int8_t channel, int8_t codec)
 {
+	TDM_PROFILE_SCOPE("aic AGC", -1);
 	uint8_t start, end, rA, rB, rC;
 	int nt, mg;
 
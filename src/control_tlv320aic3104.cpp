@@ -9,10 +9,11 @@
  */
 
 #include "control_tlv320aic3104.h"
+#include "tdm_profile.h"
 
 AudioControlTLV320AIC3104::AudioControlTLV320AIC3104(uint8_t codecs, bool useMCLK, uint8_t i2sMode, long sampleRate, int sampleLength )
 {
-	_codecs = codecs;
+	_codecs = min(codecs, AIC_MAX_CODECS);
 	_isRunning =  false;
 	_i2c = &Wire;	
 	_codec_I2C_address = AIC3104_I2C_ADDRESS;	
@@ -26,6 +27,8 @@ AudioControlTLV320AIC3104::AudioControlTLV320AIC3104(uint8_t codecs, bool useMCL
 	_sampleRate = sampleRate;
 	_dualRate = (_sampleRate > 48000);
 	_baseRate = (_sampleRate % 8000 == 0) ? 48000 : 44100;
+	for(int i = 0; i < AIC_MAX_BOARDS; i++)
+		_boardLine[i] = -1;
 }
 
 
@@ -34,6 +37,7 @@ AudioControlTLV320AIC3104::AudioControlTLV320AIC3104(uint8_t codecs, bool useMCL
 // GPIO reset will only occur once per boot cycle
 bool AudioControlTLV320AIC3104::enable(int8_t codec)
 {
+	TDM_PROFILE_SCOPE("aic enable", -1);
 	bool ok;
 
 	// this would be slow if executed, but isn't
@@ -217,12 +221,65 @@ void AudioControlTLV320AIC3104::writeR9(uint8_t codec)		// p51
 // TDM slot offset
 void AudioControlTLV320AIC3104::writeR10(uint8_t codec)	// p51
 {
-		uint8_t val = (codec * 2 * _sampleLength) + AIC_FIRST_SLOT; // TDM offset in sample length slots, 2 per codec
+		int pos = (_i2sMode == AICMODE_TDM) ? linePosition(codec) : codec;
+		int offset = (pos * 2 * slotBits()) + AIC_FIRST_SLOT; // TDM offset in slots, 2 per codec
+		if(_i2sMode == AICMODE_TDM && offset >= AIC_TDM_CLOCKS)
+			(_verbose > 0) && fprintf(stderr, "codec %i: no slots left on data line %i\n", codec, getLine(codec));
+		uint8_t val = offset;
 		if(_i2sMode == AICMODE_TDM)
 			val += AIC_TDM_OFFSET;
 		writeRegister(10, val, codec);
 }
 
+// Multiple data lines
+void AudioControlTLV320AIC3104::setBoardLine(uint8_t board, uint8_t line)
+{
+	if(board < AIC_MAX_BOARDS)
+		_boardLine[board] = constrain(line, 0, AIC_SAI2_LINE);
+}
+
+int AudioControlTLV320AIC3104::boardLine(uint8_t board)
+{
+	if(board >= AIC_MAX_BOARDS)
+		return -1;
+	if(_boardLine[board] >= 0)
+		return _boardLine[board];
+	int boardsPerLine = AIC_TDM_CLOCKS / (2 * slotBits() * AIC_CODECS_PER_BOARD);
+	return board / max(boardsPerLine, 1);
+}
+
+int AudioControlTLV320AIC3104::getLine(uint8_t codec)
+{
+	if(codec >= _codecs)
+		return -1;
+	return boardLine(codec / AIC_CODECS_PER_BOARD);
+}
+
+int AudioControlTLV320AIC3104::linePosition(uint8_t codec)
+{
+	int board = codec / AIC_CODECS_PER_BOARD;
+	int line = boardLine(board);
+	int pos = codec % AIC_CODECS_PER_BOARD;
+	for(int b = 0; b < board; b++)
+		if(boardLine(b) == line)
+			pos += AIC_CODECS_PER_BOARD;
+	return pos;
+}
+
+int AudioControlTLV320AIC3104::getChannel(uint8_t codec)
+{
+	if(codec >= _codecs)
+		return -1;
+	int line = getLine(codec) % AIC_SAI2_LINE;	// SAI2 channels count from 0
+	return line * (AIC_TDM_CLOCKS / slotBits()) + linePosition(codec) * 2;
+}
+
+// 20, 24 and 32-bit words each take a 32-bit slot, so channels stay aligned to the DMA words
+int AudioControlTLV320AIC3104::slotBits(void)
+{
+	return (_sampleLength > 16) ? 32 : 16;
+}
+
 // Change the page register for a single CODEC or all
 // Code accessing page 1 should always reset to page 0 on exit.
 void AudioControlTLV320AIC3104::setRegPage(uint8_t newPage, int8_t codec)
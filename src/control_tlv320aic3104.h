@@ -88,12 +88,13 @@
 #define AIC_OVF_DAC_R		0x10
 
 // Multi CODEC/board mode
-// 16 x 16 bit slots in Teensy TDM
-#define AIC_MAX_BOARDS 			2 		// Also number of board enable pins 
+// 16 x 16 bit slots in Teensy TDM, per data line (TDM_A_TX_LINES / TDM_A_RX_LINES)
+#define AIC_MAX_BOARDS 			8 		// Also number of board enable pins. 2 per data line at 16 bits
 #define AIC_CODECS_PER_BOARD	4		// 2 bits (also mux channels)
 #define AIC_MUX_PINS 			2 		// mux SCL: n = SQRT(AIC_CODECS_PER_BOARD)
 #define AIC_MUX_MASK			0x03	
 #define AIC_MAX_CODECS 			(AIC_CODECS_PER_BOARD * AIC_MAX_BOARDS)
+#define AIC_SAI2_LINE			4		// setBoardLine() value for boards on SAI2 (AudioInputTDM_A2 / AudioOutputTDM_A2)
 #define AIC_MAX_CHANNELS 		(AIC_MAX_CODECS * 2)
 
 // Teensy I²S uses 32-bit slots, and if both SAI1 and SAI2
@@ -145,10 +146,21 @@ enum agcHysteresis {AGCH1, AGCH2, AGCH3, AGCH_OFF};
 // Input modes
 enum inputModes {AIC_SINGLE, AIC_DIFF};
 enum channelNumbers {LEFT = 0, RIGHT = 1, BOTH = 3};
+// DAC biquad designs
+enum aicFilterType {AIC_LOWPASS, AIC_HIGHPASS, AIC_BANDPASS, AIC_NOTCH, AIC_LOWSHELF, AIC_HIGHSHELF};
 struct aic_pll {
 	unsigned long clk, p, r, j, d, q;
 	float 	k;
 };
+// I2C traffic since the last resetI2CStats(). bytes counts every byte on the bus, address bytes included.
+struct aic_i2c_stats {
+	uint32_t writes;		// codec register writes
+	uint32_t reads;			// register reads (codecs and muxes)
+	uint32_t mux_writes;	// mux channel selects
+	uint32_t probes;		// address probes (begin)
+	uint32_t bytes;
+	uint32_t errors;		// NAKs and short transfers
+};
 
 /* Implements Teensy Audio AudioControl */
 class AudioControlTLV320AIC3104  : public AudioControl
@@ -176,8 +188,15 @@ public:
 	int setPll(uint32_t clk, uint32_t p, uint32_t r, uint32_t j,uint32_t d);
 	aic_pll getPll(); // set specific variables, but do not update codec.
 	unsigned long getPllFsRef(); // return calculated fsRef for assigned pll values	
+	bool setSampleRate(long rate); // 44100, 48000, 88200 or 96000: CODECs, PLL and TDM clocks together
+	long getSampleRate() { return _sampleRate; }
 	void i2cBus(TwoWire *i2c); // Wire.begin is user responsibility 
 	void setI2Cclock(uint32_t I2Crate); // other devices may reset the clock rate
+	// I2C cost of the control calls. simulateI2C(true), before begin(): transactions are counted, not sent;
+	// begin() finds _codecs / 4 muxes and reads return 0. For benchmarks without a board.
+	void getI2CStats(aic_i2c_stats &stats) { stats = _i2cStats; }
+	void resetI2CStats() { memset(&_i2cStats, 0, sizeof(_i2cStats)); }
+	void simulateI2C(bool on) { _i2cSim = on; }
 	
 /* CODEC
 	* default arguments set all channels in all CODECs
@@ -206,6 +225,8 @@ public:
 	void setLowShelf(int stage, float frequency, float gain, float slope = 1.0f, int8_t channel = -1, int8_t codec = -1); 
 	// +/-12 dB may be a limit for shelf filters???
 	void setHighShelf(int stage, float frequency, float gain, float slope = 1.0f, int8_t channel = -1, int8_t codec = -1);
+	// Coefficients only, for setCustomFilter(), at the current sample rate: no I2C. q is the slope for shelves, gain (dB) is for shelves only.
+	void designFilter(aicFilterType type, float frequency, float q, float gain, int *coef);
 	void setFlat(int stage, int8_t channel= -1, int8_t codec = -1);
 	void setFilterOff (int8_t channel = -1, int8_t codec = -1); // disable both DAC filter stages
 
@@ -244,6 +265,13 @@ public:
 	void muxDecode(uint8_t codec);
 	int readRegister(uint8_t reg, uint8_t codec);
 	void setRegPage(uint8_t newPage, int8_t codec = -1); // change the page register
+
+	// Multiple TDM data lines: each line carries AIC_TDM_CLOCKS / (2 * slot width) CODECs, 32-bit slots above 16 bits.
+	// By default boards fill the lines in order (two boards per line at 16 bits). Issue before enable().
+	// Boards on SAI2 are planned the same way, as line AIC_SAI2_LINE.
+	void setBoardLine(uint8_t board, uint8_t line);
+	int getLine(uint8_t codec);		// data line carrying a CODEC; -1 if there is no such CODEC
+	int getChannel(uint8_t codec);	// TDM channel of the CODEC's left slot on its SAI: line * slots per line + slot; -1 if none
 protected:
 	TwoWire *_i2c = &Wire;
 	bool volumeInteger(int gainStep, int8_t channel = -1, int8_t codec = -1);
@@ -261,6 +289,9 @@ private:
 	void writeR7(uint8_t codec);
 	void writeR9(uint8_t codec);
 	void writeR10(uint8_t codec);
+	int boardLine(uint8_t board);
+	int linePosition(uint8_t codec);	// CODECs ahead of this one on its data line
+	int slotBits(void);					// TDM slot width for _sampleLength: 16 or 32
 	bool enableHpOut(bool enable, int8_t codec = -1);
 	
 	uint8_t _resetPin	= DEFAULT_RESET_PIN;
@@ -283,11 +314,14 @@ private:
 	int _lastCodec = -1; 	// used by muxDecode (force change on first use)
 	int _lastBoard = -1;
 	int8_t _codecs = 1; // default to single CODEC mode	
+	int8_t _boardLine[AIC_MAX_BOARDS];	// -1 = automatic
 	bool _reSync = false;	
 	bool _isRunning;
 	int _verbose = 0;
 
 	uint32_t _I2Cclockrate = 400000; 
+	aic_i2c_stats _i2cStats = {};
+	bool _i2cSim = false;
 	// defaults R3..R7, R11: P=8, R=1, J=1, D=0, Q=2, (K=0.0)
 	aic_pll pll = {11289600, 1, 1, 8, 0, 2, 8.0}; // TDM 44100 defaults. {clk, p, r, j, d, q, k};
 };
@@ -0,0 +1,44 @@
+/* Conversion between int32 and float blocks for the TDM_32 drivers
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#include <Arduino.h>
+#include "convert_i32.h"
+#if defined(I32_TO_F32_NORM_FACTOR)
+
+// Both convert in place: the block is only copied if another object also holds it
+void AudioConvert_I32toF32::update(void)
+{
+	audio_block_f32_t *block;
+	int32_t *p;
+
+	block = receiveWritable_f32(0);
+	if (block == nullptr) return;
+	p = tdm_i32(block);
+	for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+		block->data[i] = ((float32_t)p[i]) * I32_TO_F32_NORM_FACTOR;
+	transmit(block);
+	release(block);
+}
+
+void AudioConvert_F32toI32::update(void)
+{
+	audio_block_f32_t *block;
+	int32_t *p;
+	float32_t f;
+
+	block = receiveWritable_f32(0);
+	if (block == nullptr) return;
+	p = tdm_i32(block);
+	for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		f = block->data[i] * F32_TO_I32_NORM_FACTOR;
+		p[i] = (f >= (float32_t)F32_TO_I32_NORM_FACTOR) ? F32_TO_I32_NORM_FACTOR
+			: (f <= -(float32_t)F32_TO_I32_NORM_FACTOR) ? -F32_TO_I32_NORM_FACTOR : (int32_t)f;
+	}
+	transmit(block);
+	release(block);
+}
+
+#endif
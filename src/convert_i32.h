@@ -0,0 +1,39 @@
+/* Conversion between int32 and float blocks for the TDM_32 drivers
+ * int32 blocks (audio_block_i32_t) carry raw 24/32-bit TDM words, full scale +/- 2^31,
+ * in the data array of an F32 block. Put a converter only on the branches that feed
+ * or are fed by float objects; int32 routes between TDM_32 endpoints stay bit-transparent.
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef _convert_i32_h_
+#define _convert_i32_h_
+
+#include <Arduino.h>
+#if defined(__has_include) && __has_include(<Audiostream_F32.h>) 
+#include "AudioStream_F32.h"
+#include "output_tdm32.h"	// audio_block_i32_t, tdm_i32()
+
+// int32 block in, float block out (-1.0 .. 1.0)
+class AudioConvert_I32toF32 : public AudioStream_F32
+{
+public:
+	AudioConvert_I32toF32(void) : AudioStream_F32(1, inputQueueArray) {}
+	virtual void update(void);
+private:
+	audio_block_f32_t *inputQueueArray[1];
+};
+
+// float block in, int32 block out, saturated
+class AudioConvert_F32toI32 : public AudioStream_F32
+{
+public:
+	AudioConvert_F32toI32(void) : AudioStream_F32(1, inputQueueArray) {}
+	virtual void update(void);
+private:
+	audio_block_f32_t *inputQueueArray[1];
+};
+
+#endif // F32 library available
+#endif
@@ -34,27 +34,25 @@
 #if defined(__has_include) && __has_include(<Audiostream_F32.h>) 
 #include "AudioStream_F32.h"
 #include <DMAChannel.h> 
+#include "output_tdm32.h"	// tdm_format_32, TDM_32_SAI
 
 #define TDM_CHANNELS 8
-#define I32_TO_F32_NORM_FACTOR (4.656612875245797e-10)   //which is 1/(2^31 - 1)
-class AudioInputTDM_32 : public AudioStream_F32
+
+class AudioInputTDM_32 : public AudioInputTDM_Engine<tdm_format_32, TDM_32_SAI>
 {
 public:
-	AudioInputTDM_32(void) : AudioStream_F32(0, NULL) { begin(); } 
-	AudioInputTDM_32(int sampleLength = 32, float sampleRate = 44100.0) : AudioStream_F32(0, NULL) 
+	AudioInputTDM_32(void) { begin(); } 
+	AudioInputTDM_32(int sampleLength = 32, float sampleRate = 44100.0) 
 		{ begin(sampleLength, sampleRate); }
-	virtual void update(void);
-	void begin(int sampleLength = 32, float sampleRate = 44100.0);
+	void begin(int sampleLength = 32, float sampleRate = 44100.0) { begin_engine(true); }
 	void scale_i32_to_f32( int32_t *p_i32, float32_t *p_f32, int len);
-	int getDMAbal(void);
+	// true: blocks carry the received int32 samples unchanged (audio_block_i32_t), no float conversion
+	void setInt32(bool on) { int32_blocks = on; }
+	bool getInt32(void) { return int32_blocks; }
 protected:	
-	static bool update_responsibility;
-	static DMAChannel dma;
-	static void isr(void);
 	//static int audio_block_samples;
 	static float sample_rate_Hz;
-private:
-	static audio_block_f32_t *block_incoming[8];
 };
+extern template class AudioInputTDM_Engine<tdm_format_32, TDM_32_SAI>;
 #endif // F32 library available
 #endif
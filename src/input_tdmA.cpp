@@ -27,169 +27,29 @@
 
 #include <Arduino.h>
 #include "input_tdmA.h"
-#include "output_tdmA.h"
 #if defined(KINETISK) || defined(__IMXRT1062__)
-#include "utility/imxrt_hw.h"
 
-DMAMEM __attribute__((aligned(32)))
-static uint32_t tdm_rx_buffer[AUDIO_BLOCK_SAMPLES*16];
-audio_block_t * AudioInputTDM_A::block_incoming[16] = {
-	nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-	nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr
-};
-bool AudioInputTDM_A::update_responsibility = false;
-DMAChannel AudioInputTDM_A::dma(false);
-static int _sampleLengthI;
-
-void AudioInputTDM_A::begin(int sampleLength)
-{
-	_sampleLengthI = sampleLength;
-	dma.begin(true); // Allocate the DMA channel first
-
-	// TODO: should we set & clear the I2S_RCSR_SR bit here?
-	AudioOutputTDM_A::config_tdm();
-#if defined(KINETISK)
-	CORE_PIN13_CONFIG = PORT_PCR_MUX(4); // pin 13, PTC5, I2S0_RXD0
-	dma.TCD->SADDR = &I2S0_RDR0;
-	dma.TCD->SOFF = 0;
-	dma.TCD->ATTR = DMA_TCD_ATTR_SSIZE(2) | DMA_TCD_ATTR_DSIZE(2);
-	dma.TCD->NBYTES_MLNO = 4;
-	dma.TCD->SLAST = 0;
-	dma.TCD->DADDR = tdm_rx_buffer;
-	dma.TCD->DOFF = 4;
-	dma.TCD->CITER_ELINKNO = sizeof(tdm_rx_buffer) / 4;
-	dma.TCD->DLASTSGA = -sizeof(tdm_rx_buffer);
-	dma.TCD->BITER_ELINKNO = sizeof(tdm_rx_buffer) / 4;
-	dma.TCD->CSR = DMA_TCD_CSR_INTHALF | DMA_TCD_CSR_INTMAJOR;
-	dma.triggerAtHardwareEvent(DMAMUX_SOURCE_I2S0_RX);
-	update_responsibility = update_setup();
-	dma.enable();
-
-	I2S0_RCSR |= I2S_RCSR_RE | I2S_RCSR_BCE | I2S_RCSR_FRDE | I2S_RCSR_FR;
-	I2S0_TCSR |= I2S_TCSR_TE | I2S_TCSR_BCE; // TX clock enable, because sync'd to TX
-	dma.attachInterrupt(isr);
-#elif defined(__IMXRT1062__)
-	CORE_PIN8_CONFIG  = 3;  //RX_DATA0
-	IOMUXC_SAI1_RX_DATA0_SELECT_INPUT = 2;
-	dma.TCD->SADDR = &I2S1_RDR0;
-	dma.TCD->SOFF = 0;
-	dma.TCD->ATTR = DMA_TCD_ATTR_SSIZE(2) | DMA_TCD_ATTR_DSIZE(2);
-	dma.TCD->NBYTES_MLNO = 4;
-	dma.TCD->SLAST = 0;
-	dma.TCD->DADDR = tdm_rx_buffer;
-	dma.TCD->DOFF = 4;
-	dma.TCD->CITER_ELINKNO = sizeof(tdm_rx_buffer) / 4;
-	dma.TCD->DLASTSGA = -sizeof(tdm_rx_buffer);
-	dma.TCD->BITER_ELINKNO = sizeof(tdm_rx_buffer) / 4;
-	dma.TCD->CSR = DMA_TCD_CSR_INTHALF | DMA_TCD_CSR_INTMAJOR;
-	dma.triggerAtHardwareEvent(DMAMUX_SOURCE_SAI1_RX);
-	update_responsibility = update_setup();
-	dma.enable();
-
-	I2S1_RCSR = I2S_RCSR_RE | I2S_RCSR_BCE | I2S_RCSR_FRDE | I2S_RCSR_FR;
-	dma.attachInterrupt(isr);	
-#endif	
-}
-
-// TODO: needs optimization...
-// 8 x 32-bit samples
-static void memcpy_tdm_rx(uint32_t *dest1, uint32_t *dest2, const uint32_t *src)
-{
-	uint32_t i, in1, in2;
-	for (i=0; i < AUDIO_BLOCK_SAMPLES/2; i++) {
-		in1 = *src;
-		in2 = *(src+8);
-		src += 16;
-		*dest1++ = (in1 >> 16) | (in2 & 0xFFFF0000);
-		//*dest2++ = (in1 << 16) | (in2 & 0x0000FFFF);		
-		*dest2++ = (in1 & 0x0000FFFF)  | (in2 << 16);		// Fixed RP
-	}
-}
-
-
-// transfer all 16-bit samples for two channels from this 32-bit DMA block (half of 16 x AUDIO_BLOCK_SAMPLES) RP
-static void memcpy_tdm_rx_16(uint16_t *dest1, uint16_t *dest2, const uint32_t *src)
-{
-	uint32_t i, in1;
-	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) { // 2 samples per word
-		in1 = *src;
-		*dest1++ = (uint16_t)((in1 >> 16) & 0x0000FFFF);
-		*dest2++ = (uint16_t)(in1 & 0x0000FFFF);
-		src += 8; // 2 samples per word
-	}
-}
-
-void AudioInputTDM_A::isr(void)
-{
-	uint32_t daddr;
-	const uint32_t *src;
-	unsigned int i;
-
-	daddr = (uint32_t)(dma.TCD->DADDR);
-	dma.clearInterrupt();
-
-	if (daddr < (uint32_t)tdm_rx_buffer + sizeof(tdm_rx_buffer) / 2) {
-		// DMA is receiving to the first half of the buffer
-		// need to remove data from the second half
-		src = &tdm_rx_buffer[AUDIO_BLOCK_SAMPLES*8];
-	} else {
-		// DMA is receiving to the second half of the buffer
-		// need to remove data from the first half
-		src = &tdm_rx_buffer[0];
-	}
-	if (block_incoming[0] != nullptr) {
-		#if IMXRT_CACHE_ENABLED >=1
-		arm_dcache_delete((void*)src, sizeof(tdm_rx_buffer) / 2);
-		#endif
-	if(_sampleLengthI == 16)
-		
-		for (i=0; i < 16; i += 2) { // channel pairs RP
-			uint16_t *dest1 = (uint16_t *)block_incoming[i]->data;
-			uint16_t *dest2 = (uint16_t *)block_incoming[i+1]->data;
-			memcpy_tdm_rx_16(dest1, dest2, src);
-			src++;
-		}
-	else
-		for (i=0; i < 16; i += 2) { // channel pairs
-			uint32_t *dest1 = (uint32_t *)(block_incoming[i]->data);
-			uint32_t *dest2 = (uint32_t *)(block_incoming[i+1]->data);
-			memcpy_tdm_rx(dest1, dest2, src);
-			src++;
-		}
-	}
-	if (update_responsibility) update_all();
-}
-
-
-void AudioInputTDM_A::update(void)
-{
-	unsigned int i, j;
-	audio_block_t *new_block[16];
-	audio_block_t *out_block[16];
+#if defined(TDM_A_DMA_DEINTERLEAVE)
+#if !defined(__IMXRT1062__)
+#error "TDM_A_DMA_DEINTERLEAVE requires Teensy 4"
+#endif
+#if TDM_A_DMA_FRAMES < AUDIO_BLOCK_SAMPLES
+#error "TDM_A_DMA_DEINTERLEAVE needs TDM_A_DMA_FRAMES = AUDIO_BLOCK_SAMPLES"
+#endif
+#if TDM_A_RX_LINES == 3
+#error "TDM_A_DMA_DEINTERLEAVE needs 1, 2 or 4 receive lines" // source wraps over the RDR registers with SMOD
+#endif
+#endif
+#if TDM_A_RX_LINES > 1 && !defined(__IMXRT1062__)
+#error "TDM_A_RX_LINES above 1 requires Teensy 4"
+#endif
 
-	// allocate 16 new blocks.  If any fails, allocate none
-	for (i=0; i < 16; i++) {
-		new_block[i] = allocate();
-		if (new_block[i] == nullptr) {
-			for (j=0; j < i; j++) {
-				release(new_block[j]);
-			}
-			memset(new_block, 0, sizeof(new_block));
-			break;
-		}
-	}
-	__disable_irq();
-	memcpy(out_block, block_incoming, sizeof(out_block));
-	memcpy(block_incoming, new_block, sizeof(block_incoming));
-	__enable_irq();
-	if (out_block[0] != nullptr) {
-		// if we got 1 block, all 16 are filled
-		for (i=0; i < 16; i++) {
-			transmit(out_block[i], i);
-			release(out_block[i]);
-		}
-	}
-}
+uint32_t tdm_format_A::dither_seed = 0x12345678;	// xorshift32 state: never zero
 
+// The driver is AudioInputTDM_Engine (tdm_engine.h), instantiated here once per SAI
+template class AudioInputTDM_Engine<tdm_format_A, 1>;
+#if defined(TDM_A_SAI2)
+template class AudioInputTDM_Engine<tdm_format_A, 2>;
+#endif
 
 #endif
@@ -31,19 +31,26 @@
 #include <Arduino.h>     // github.com/PaulStoffregen/cores/blob/master/teensy4/Arduino.h
 #include <AudioStream.h> // github.com/PaulStoffregen/cores/blob/master/teensy4/AudioStream.h
 #include <DMAChannel.h>  // github.com/PaulStoffregen/cores/blob/master/teensy4/DMAChannel.h
+#include "output_tdmA.h"  // tdm_format_A and the TDM_A options
 
-class AudioInputTDM_A : public AudioStream
+// AudioInputTDM_A runs on SAI1; AudioInputTDM_A2 on SAI2 with one data line (Teensy 4, TDM_A_SAI2).
+// Channel masks are tdm_mask_t for every instance.
+class AudioInputTDM_A : public AudioInputTDM_Engine<tdm_format_A, 1>
 {
 public:
-	AudioInputTDM_A(int sampleLength = 16) : AudioStream(0, NULL) { begin(sampleLength); }
-	virtual void update(void);
-	void begin(int sampleLength = 16);
-protected:	
-	static bool update_responsibility;
-	static DMAChannel dma;
-	static void isr(void);
-private:
-	static audio_block_t *block_incoming[16];
+	AudioInputTDM_A(int sampleLength = 16) { begin(sampleLength); }
+	void begin(int sampleLength = 16) { begin_engine(true); }
 };
+extern template class AudioInputTDM_Engine<tdm_format_A, 1>;
+
+#if defined(TDM_A_SAI2)
+class AudioInputTDM_A2 : public AudioInputTDM_Engine<tdm_format_A, 2>
+{
+public:
+	AudioInputTDM_A2(int sampleLength = 16) { begin(sampleLength); }
+	void begin(int sampleLength = 16) { begin_engine(true); }
+};
+extern template class AudioInputTDM_Engine<tdm_format_A, 2>;
+#endif
 
 #endif
@@ -0,0 +1,344 @@
+/* TDM interleave/deinterleave kernels for the TDM_A and TDM_B drivers
+ * TDM_A: 16 x 16-bit slots per frame, two slots per 32-bit DMA word
+ * (even slot in the upper half, odd slot in the lower half)
+ * TDM_B: 16 x 32-bit slots per frame, 16-bit samples in the upper half
+ * TDM_A with 24/32-bit codec words: 8 x 32-bit slots per frame, reduced to 16 bits with dither
+ *
+ * Used by the formats of the TDM engine (tdm_engine.h) and the TDM_Benchmark example.
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef _memcpy_tdm_h_
+#define _memcpy_tdm_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>      // AUDIO_BLOCK_SAMPLES
+#include "utility/dspinst.h" // pack_16t_16t(), pack_16b_16b(): PKHTB/PKHBT on Cortex-M4/M7
+#include "tdm_meter.h"
+#include "tdm_gain.h"
+
+#define TDM_A_FRAME_WORDS	8	// 32-bit DMA words per 16-slot frame on one data line
+
+// The kernels take the frame stride in words as a template parameter:
+// TDM_A_FRAME_WORDS * number of data lines, as the DMA interleaves the lines word by word.
+
+// Deinterleave one slot pair (two channels) from a half DMA buffer.
+// src points to the pair's word in the first frame; frames is a multiple of 8.
+// Two frames are combined with PKHTB/PKHBT so every store writes two samples to each block.
+// METER: also add both channels to meter[0] and meter[1] (tdm_meter.h) from the packed words.
+// GAIN: then scale them by gain[0] and gain[1] (tdm_gain.h), one gain step per word.
+template <int STRIDE = TDM_A_FRAME_WORDS, bool METER = false, bool GAIN = false>
+static inline void memcpy_tdm_rx_16(int16_t *dest1, int16_t *dest2, const uint32_t *src, int frames = AUDIO_BLOCK_SAMPLES,
+	tdm_meter_acc *meter = nullptr, tdm_gain *gain = nullptr)
+{
+	uint32_t *d1 = (uint32_t *)dest1;
+	uint32_t *d2 = (uint32_t *)dest2;
+	const uint32_t *end = d1 + frames/2;
+	uint32_t in1, in2, in3, in4, out1, out2, out3, out4;
+	uint32_t mx1 = 0x80008000, mn1 = 0x7FFF7FFF, mx2 = 0x80008000, mn2 = 0x7FFF7FFF;
+	uint64_t power1 = 0, power2 = 0;
+	tdm_gain g1, g2;
+
+	if (GAIN) {
+		g1 = gain[0];
+		g2 = gain[1];
+	}
+	do { // 8 frames per pass
+		in1 = src[0];
+		in2 = src[STRIDE];
+		in3 = src[STRIDE*2];
+		in4 = src[STRIDE*3];
+		out1 = pack_16t_16t(in2, in1); // upper halves: even slot
+		out2 = pack_16b_16b(in2, in1); // lower halves: odd slot
+		out3 = pack_16t_16t(in4, in3);
+		out4 = pack_16b_16b(in4, in3);
+		if (METER) {
+			tdm_meter_x2(out1, mx1, mn1, power1);
+			tdm_meter_x2(out2, mx2, mn2, power2);
+			tdm_meter_x2(out3, mx1, mn1, power1);
+			tdm_meter_x2(out4, mx2, mn2, power2);
+		}
+		if (GAIN) {
+			out1 = tdm_gain_x2(out1, tdm_gain_next(g1));
+			out2 = tdm_gain_x2(out2, tdm_gain_next(g2));
+			out3 = tdm_gain_x2(out3, tdm_gain_next(g1));
+			out4 = tdm_gain_x2(out4, tdm_gain_next(g2));
+		}
+		d1[0] = out1;
+		d2[0] = out2;
+		d1[1] = out3;
+		d2[1] = out4;
+
+		in1 = src[STRIDE*4];
+		in2 = src[STRIDE*5];
+		in3 = src[STRIDE*6];
+		in4 = src[STRIDE*7];
+		out1 = pack_16t_16t(in2, in1);
+		out2 = pack_16b_16b(in2, in1);
+		out3 = pack_16t_16t(in4, in3);
+		out4 = pack_16b_16b(in4, in3);
+		if (METER) {
+			tdm_meter_x2(out1, mx1, mn1, power1);
+			tdm_meter_x2(out2, mx2, mn2, power2);
+			tdm_meter_x2(out3, mx1, mn1, power1);
+			tdm_meter_x2(out4, mx2, mn2, power2);
+		}
+		if (GAIN) {
+			out1 = tdm_gain_x2(out1, tdm_gain_next(g1));
+			out2 = tdm_gain_x2(out2, tdm_gain_next(g2));
+			out3 = tdm_gain_x2(out3, tdm_gain_next(g1));
+			out4 = tdm_gain_x2(out4, tdm_gain_next(g2));
+		}
+		d1[2] = out1;
+		d2[2] = out2;
+		d1[3] = out3;
+		d2[3] = out4;
+
+		src += STRIDE*8;
+		d1 += 4;
+		d2 += 4;
+	} while (d1 < end);
+	if (METER) {
+		tdm_meter_fold(&meter[0], mx1, mn1, power1);
+		tdm_meter_fold(&meter[1], mx2, mn2, power2);
+	}
+	if (GAIN) {
+		gain[0] = g1;
+		gain[1] = g2;
+	}
+}
+
+// Deinterleave only the even (upper half) slot of a pair. METER, GAIN: as memcpy_tdm_rx_16(), for meter[0] and gain[0].
+template <int STRIDE = TDM_A_FRAME_WORDS, bool METER = false, bool GAIN = false>
+static inline void memcpy_tdm_rx_16_even(int16_t *dest, const uint32_t *src, int frames = AUDIO_BLOCK_SAMPLES,
+	tdm_meter_acc *meter = nullptr, tdm_gain *gain = nullptr)
+{
+	uint32_t *d = (uint32_t *)dest;
+	const uint32_t *end = d + frames/2;
+	uint32_t out1, out2, out3, out4, mx = 0x80008000, mn = 0x7FFF7FFF;
+	uint64_t power = 0;
+	tdm_gain g;
+
+	if (GAIN) g = gain[0];
+	do { // 8 frames per pass
+		out1 = pack_16t_16t(src[STRIDE], src[0]);
+		out2 = pack_16t_16t(src[STRIDE*3], src[STRIDE*2]);
+		out3 = pack_16t_16t(src[STRIDE*5], src[STRIDE*4]);
+		out4 = pack_16t_16t(src[STRIDE*7], src[STRIDE*6]);
+		if (METER) {
+			tdm_meter_x2(out1, mx, mn, power);
+			tdm_meter_x2(out2, mx, mn, power);
+			tdm_meter_x2(out3, mx, mn, power);
+			tdm_meter_x2(out4, mx, mn, power);
+		}
+		if (GAIN) {
+			out1 = tdm_gain_x2(out1, tdm_gain_next(g));
+			out2 = tdm_gain_x2(out2, tdm_gain_next(g));
+			out3 = tdm_gain_x2(out3, tdm_gain_next(g));
+			out4 = tdm_gain_x2(out4, tdm_gain_next(g));
+		}
+		d[0] = out1;
+		d[1] = out2;
+		d[2] = out3;
+		d[3] = out4;
+		src += STRIDE*8;
+		d += 4;
+	} while (d < end);
+	if (METER) tdm_meter_fold(&meter[0], mx, mn, power);
+	if (GAIN) gain[0] = g;
+}
+
+// Deinterleave only the odd (lower half) slot of a pair
+template <int STRIDE = TDM_A_FRAME_WORDS>
+static inline void memcpy_tdm_rx_16_odd(int16_t *dest, const uint32_t *src, int frames = AUDIO_BLOCK_SAMPLES)
+{
+	uint32_t *d = (uint32_t *)dest;
+	const uint32_t *end = d + frames/2;
+
+	do { // 8 frames per pass
+		d[0] = pack_16b_16b(src[STRIDE], src[0]);
+		d[1] = pack_16b_16b(src[STRIDE*3], src[STRIDE*2]);
+		d[2] = pack_16b_16b(src[STRIDE*5], src[STRIDE*4]);
+		d[3] = pack_16b_16b(src[STRIDE*7], src[STRIDE*6]);
+		src += STRIDE*8;
+		d += 4;
+	} while (d < end);
+}
+
+// Interleave two channel blocks into one slot pair of a half DMA buffer.
+// dest points to the pair's word in the first frame; frames is a multiple of 8.
+// Each 32-bit read carries two samples of a channel; PKHBT/PKHTB build two frames from them.
+// GAIN: scale the even and odd slots by gain[0] and gain[1] (tdm_gain.h), one gain step per read.
+template <int STRIDE = TDM_A_FRAME_WORDS, bool GAIN = false>
+static inline void memcpy_tdm_tx(uint32_t *dest, const uint32_t *src1, const uint32_t *src2, int frames = AUDIO_BLOCK_SAMPLES,
+	tdm_gain *gain = nullptr)
+{
+	const uint32_t *end = src1 + frames/2;
+	uint32_t in1, in2, in3, in4;
+	tdm_gain g1, g2;
+
+	if (GAIN) {
+		g1 = gain[0];
+		g2 = gain[1];
+	}
+	do { // 8 frames per pass
+		in1 = src1[0];
+		in2 = src2[0];
+		in3 = src1[1];
+		in4 = src2[1];
+		if (GAIN) {
+			in1 = tdm_gain_x2(in1, tdm_gain_next(g1));
+			in2 = tdm_gain_x2(in2, tdm_gain_next(g2));
+			in3 = tdm_gain_x2(in3, tdm_gain_next(g1));
+			in4 = tdm_gain_x2(in4, tdm_gain_next(g2));
+		}
+		dest[0] = pack_16b_16b(in1, in2);
+		dest[STRIDE] = pack_16t_16t(in1, in2);
+		dest[STRIDE*2] = pack_16b_16b(in3, in4);
+		dest[STRIDE*3] = pack_16t_16t(in3, in4);
+
+		in1 = src1[2];
+		in2 = src2[2];
+		in3 = src1[3];
+		in4 = src2[3];
+		if (GAIN) {
+			in1 = tdm_gain_x2(in1, tdm_gain_next(g1));
+			in2 = tdm_gain_x2(in2, tdm_gain_next(g2));
+			in3 = tdm_gain_x2(in3, tdm_gain_next(g1));
+			in4 = tdm_gain_x2(in4, tdm_gain_next(g2));
+		}
+		dest[STRIDE*4] = pack_16b_16b(in1, in2);
+		dest[STRIDE*5] = pack_16t_16t(in1, in2);
+		dest[STRIDE*6] = pack_16b_16b(in3, in4);
+		dest[STRIDE*7] = pack_16t_16t(in3, in4);
+
+		dest += STRIDE*8;
+		src1 += 4;
+		src2 += 4;
+	} while (src1 < end);
+	if (GAIN) {
+		gain[0] = g1;
+		gain[1] = g2;
+	}
+}
+
+// TDM_B, and TDM_A with 24/32-bit words: one channel block into the upper halves of 32-bit slots,
+// lower halves zero. GAIN: scale it by gain[0], one gain step per read.
+// Deinterleaving the upper halves is memcpy_tdm_rx_16_even().
+template <int STRIDE, bool GAIN = false>
+static inline void memcpy_tdm_tx_32(uint32_t *dest, const uint32_t *src, int frames = AUDIO_BLOCK_SAMPLES,
+	tdm_gain *gain = nullptr)
+{
+	const uint32_t *end = src + frames/2;
+	uint32_t in1, in2;
+	tdm_gain g;
+
+	if (GAIN) g = gain[0];
+	do { // 8 frames per pass
+		in1 = src[0];
+		in2 = src[1];
+		if (GAIN) {
+			in1 = tdm_gain_x2(in1, tdm_gain_next(g));
+			in2 = tdm_gain_x2(in2, tdm_gain_next(g));
+		}
+		dest[0] = in1 << 16;
+		dest[STRIDE] = in1 & 0xFFFF0000;
+		dest[STRIDE*2] = in2 << 16;
+		dest[STRIDE*3] = in2 & 0xFFFF0000;
+
+		in1 = src[2];
+		in2 = src[3];
+		if (GAIN) {
+			in1 = tdm_gain_x2(in1, tdm_gain_next(g));
+			in2 = tdm_gain_x2(in2, tdm_gain_next(g));
+		}
+		dest[STRIDE*4] = in1 << 16;
+		dest[STRIDE*5] = in1 & 0xFFFF0000;
+		dest[STRIDE*6] = in2 << 16;
+		dest[STRIDE*7] = in2 & 0xFFFF0000;
+
+		dest += STRIDE*8;
+		src += 4;
+	} while (src < end);
+	if (GAIN) gain[0] = g;
+}
+
+// 24 and 32-bit codec words in 32-bit slots (one channel per DMA word), reduced to 16 bits.
+// TPDF dither: the sum of two uniform values of +/- half a 16-bit LSB, from one xorshift32 draw,
+// is added below bit 16 before the top half is rounded off with saturation. mask clears the bits
+// below a 24-bit word. With dither off the word is truncated.
+// METER: also add the 16-bit results to meter[0]. GAIN: scale the words by gain[0] first.
+template <int STRIDE, bool METER = false, bool GAIN = false>
+static inline void memcpy_tdm_rx_32to16(int16_t *dest, const uint32_t *src, uint32_t &seed, bool dither, uint32_t mask,
+	int frames = AUDIO_BLOCK_SAMPLES, tdm_meter_acc *meter = nullptr, tdm_gain *gain = nullptr)
+{
+	uint32_t r = seed;
+	int32_t x, d, mx = 0, mn = 0;
+	uint64_t power = 0;
+	tdm_gain g;
+
+	if (METER) {
+		mx = meter->max;
+		mn = meter->min;
+	}
+	if (GAIN) g = gain[0];
+	for (int j = 0; j < frames; j++) {
+		x = src[j*STRIDE] & mask;
+		if (GAIN) x = tdm_gain_32(x, (j & 1) ? g.now : tdm_gain_next(g));	// steps per pair, as the 16-bit kernels
+		if (dither) {
+			r ^= r << 13;
+			r ^= r >> 17;
+			r ^= r << 5;
+			d = (int32_t)(r & 0xFFFF) - (int32_t)(r >> 16);	// triangular, -65535 .. 65535
+			x = (x >> 16) + (((x & 0xFFFF) + d + 0x8000) >> 16);	// rounded; no overflow: the carry is -1 .. 2
+			x = signed_saturate_rshift(x, 16, 0);
+		} else {
+			x = x >> 16;
+		}
+		dest[j] = x;
+		if (METER) tdm_meter_1(x, mx, mn, power);
+	}
+	seed = r;
+	if (METER) {
+		meter->max = mx;
+		meter->min = mn;
+		meter->power += power;
+	}
+	if (GAIN) gain[0] = g;
+}
+
+// Silence one slot pair (TDM_A) or slot (TDM_B) of a half DMA buffer
+template <int STRIDE = TDM_A_FRAME_WORDS>
+static inline void memset_tdm_tx(uint32_t *dest, int frames = AUDIO_BLOCK_SAMPLES)
+{
+	const uint32_t *end = dest + frames*STRIDE;
+
+	do {
+		dest[0] = 0;
+		dest[STRIDE] = 0;
+		dest[STRIDE*2] = 0;
+		dest[STRIDE*3] = 0;
+		dest += STRIDE*4;
+	} while (dest < end);
+}
+
+// Sample access for the low-latency callback.
+// buf holds interleaved frames as the DMA sends them; slot = line * 16 + slot on that line.
+static inline int16_t tdm_a_get(const uint32_t *buf, int frame, int slot, int lines = 1)
+{
+	uint32_t w = buf[(frame * TDM_A_FRAME_WORDS + ((slot & 15) >> 1)) * lines + (slot >> 4)];
+	return (slot & 1) ? (int16_t)w : (int16_t)(w >> 16);
+}
+
+static inline void tdm_a_put(uint32_t *buf, int frame, int slot, int16_t sample, int lines = 1)
+{
+	uint32_t *w = &buf[(frame * TDM_A_FRAME_WORDS + ((slot & 15) >> 1)) * lines + (slot >> 4)];
+	if (slot & 1)
+		*w = (*w & 0xFFFF0000) | (uint16_t)sample;
+	else
+		*w = (*w & 0x0000FFFF) | ((uint32_t)(uint16_t)sample << 16);
+}
+
+#endif
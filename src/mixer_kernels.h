@@ -0,0 +1,191 @@
+/* Gain kernels for the AudioMixerMatrix example (examples/MatrixMixer)
+ * applyGain() starts an output block from its first input, applyGainThenAdd() adds the rest.
+ * A ramping crosspoint passes the change in gain across the block; settled gains pass 0.
+ * Cortex-M4/M7 use Q16 gains, two samples per word; Teensy LC uses Q8.
+ *
+ * Used by the mixer and the BenchmarkJSON example.
+ *
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Modified by Macaba, palmerr23 (2019, 2025)
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _mixer_kernels_h_
+#define _mixer_kernels_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>      // AUDIO_BLOCK_SAMPLES
+#include "utility/dspinst.h"
+
+// A ramp's change over one block, split into steps that add up to it exactly, so the block
+// ends on the gain the next one starts from: the first (returned) steps are one unit bigger.
+static inline int rampSplit(int32_t change, int steps, int32_t &step, int32_t &stepFirst)
+{
+	int rem;
+
+	step = change / steps;
+	rem = change - step * steps;
+	stepFirst = step + ((rem < 0) ? -1 : 1);
+	return (rem < 0) ? -rem : rem;
+}
+
+#if defined(__ARM_ARCH_7EM__)
+#define MULTI_UNITYGAIN 65536
+#define RAMP_STEPS (AUDIO_BLOCK_SAMPLES / 2) // the kernels step the gain once per sample pair
+#define RAMP_CHANGE(d) (d)
+
+// first input of an output: copy with gain, so the output needs no zeroing.
+// change: what mult moves by across the block while the crosspoint ramps, in steps per sample pair.
+static inline void applyGain(int16_t *data, const int16_t *in, int32_t mult, int32_t change)
+{
+	uint32_t *p = (uint32_t *)data;
+	const uint32_t *src = (uint32_t *)in;
+	const uint32_t *end = (uint32_t *)(data + AUDIO_BLOCK_SAMPLES);
+
+	if (change) {
+		int32_t step, stepFirst;
+		const uint32_t *split = p + rampSplit(change, RAMP_STEPS, step, stepFirst);
+		do {
+			uint32_t tmp32 = *src++;
+			int32_t val1 = signed_multiply_32x16b(mult, tmp32);
+			int32_t val2 = signed_multiply_32x16t(mult, tmp32);
+			mult += (p < split) ? stepFirst : step;
+			val1 = signed_saturate_rshift(val1, 16, 0);
+			val2 = signed_saturate_rshift(val2, 16, 0);
+			*p++ = pack_16b_16b(val2, val1);
+		} while (p < end);
+		return;
+	}
+	if (mult == MULTI_UNITYGAIN) {
+		memcpy(data, in, AUDIO_BLOCK_SAMPLES * sizeof(int16_t));
+		return;
+	}
+	do {
+		uint32_t tmp32 = *src++; // read 2 samples from *in
+		int32_t val1 = signed_multiply_32x16b(mult, tmp32);
+		int32_t val2 = signed_multiply_32x16t(mult, tmp32);
+		val1 = signed_saturate_rshift(val1, 16, 0);
+		val2 = signed_saturate_rshift(val2, 16, 0);
+		*p++ = pack_16b_16b(val2, val1);
+	} while (p < end);
+}
+
+static inline void applyGainThenAdd(int16_t *data, const int16_t *in, int32_t mult, int32_t change)
+{
+	uint32_t *dst = (uint32_t *)data;
+	const uint32_t *src = (uint32_t *)in;
+	const uint32_t *end = (uint32_t *)(data + AUDIO_BLOCK_SAMPLES);
+
+	if (change) {
+		int32_t step, stepFirst;
+		const uint32_t *split = dst + rampSplit(change, RAMP_STEPS, step, stepFirst);
+		do {
+			uint32_t tmp32 = *src++;
+			int32_t val1 = signed_multiply_32x16b(mult, tmp32);
+			int32_t val2 = signed_multiply_32x16t(mult, tmp32);
+			mult += (dst < split) ? stepFirst : step;
+			val1 = signed_saturate_rshift(val1, 16, 0);
+			val2 = signed_saturate_rshift(val2, 16, 0);
+			tmp32 = pack_16b_16b(val2, val1);
+			uint32_t tmp32b = *dst;
+			*dst++ = signed_add_16_and_16(tmp32, tmp32b);
+		} while (dst < end);
+	} else if (mult == MULTI_UNITYGAIN) {
+		do {
+			uint32_t tmp32 = *dst;
+			*dst++ = signed_add_16_and_16(tmp32, *src++);
+			tmp32 = *dst;
+			*dst++ = signed_add_16_and_16(tmp32, *src++);
+		} while (dst < end);
+	} else {
+		do {
+			uint32_t tmp32 = *src++; // read 2 samples from *data
+			int32_t val1 = signed_multiply_32x16b(mult, tmp32);
+			int32_t val2 = signed_multiply_32x16t(mult, tmp32);
+			val1 = signed_saturate_rshift(val1, 16, 0);
+			val2 = signed_saturate_rshift(val2, 16, 0);
+			tmp32 = pack_16b_16b(val2, val1);
+			uint32_t tmp32b = *dst;
+			*dst++ = signed_add_16_and_16(tmp32, tmp32b);
+		} while (dst < end);
+	}
+}
+
+#elif defined(KINETISL)
+#define MULTI_UNITYGAIN 256
+#define RAMP_STEPS AUDIO_BLOCK_SAMPLES
+#define RAMP_CHANGE(d) ((d) << 8)
+
+// mult is Q8; while ramping it is carried as Q16 (change too) for a smooth ramp
+static inline void applyGain(int16_t *data, const int16_t *in, int32_t mult, int32_t change)
+{
+	const int16_t *end = data + AUDIO_BLOCK_SAMPLES;
+
+	if (change) {
+		int32_t step, stepFirst;
+		const int16_t *split = data + rampSplit(change, RAMP_STEPS, step, stepFirst);
+		mult <<= 8;
+		do {
+			int32_t val = (*in++ * (mult >> 8)) >> 8;
+			mult += (data < split) ? stepFirst : step;
+			*data++ = signed_saturate_rshift(val, 16, 0);
+		} while (data < end);
+		return;
+	}
+	do {
+		int32_t val = (*in++ * mult) >> 8;
+		*data++ = signed_saturate_rshift(val, 16, 0);
+	} while (data < end);
+}
+
+static inline void applyGainThenAdd(int16_t *dst, const int16_t *src, int32_t mult, int32_t change)
+{
+	const int16_t *end = dst + AUDIO_BLOCK_SAMPLES;
+
+	if (change) {
+		int32_t step, stepFirst;
+		const int16_t *split = dst + rampSplit(change, RAMP_STEPS, step, stepFirst);
+		mult <<= 8;
+		do {
+			int32_t val = *dst + ((*src++ * (mult >> 8)) >> 8);
+			mult += (dst < split) ? stepFirst : step;
+			*dst++ = signed_saturate_rshift(val, 16, 0);
+		} while (dst < end);
+	} else if (mult == MULTI_UNITYGAIN) {
+		do {
+			int32_t val = *dst + *src++;
+			*dst++ = signed_saturate_rshift(val, 16, 0);
+		} while (dst < end);
+	} else {
+		do {
+			int32_t val = *dst + ((*src++ * mult) >> 8); // overflow possible??
+			*dst++ = signed_saturate_rshift(val, 16, 0);
+		} while (dst < end);
+	}
+}
+
+#endif
+
+#endif
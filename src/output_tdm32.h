@@ -37,6 +37,124 @@
 // #define SAMPLE_LENGTH	32 
 // #define CHANNELS 8
 #define TDM_CHANNELS 8
+
+// DMA period in frames, for both TDM_32 input and output: 16, 32, 64 or AUDIO_BLOCK_SAMPLES (default).
+// Below AUDIO_BLOCK_SAMPLES the receive ISR assembles audio blocks from sub-blocks and the transmit ISR
+// starts on new blocks at the next sub-block, cutting the round trip through the audio graph.
+#define TDM_32_DMA_FRAMES	AUDIO_BLOCK_SAMPLES
+
+// SAI for the TDM_32 input and output: 1, or 2 on Teensy 4 (pins as TDM_A_SAI2)
+#define TDM_32_SAI	1
+
+// Deinterleave in the eDMA instead of the ISR (Teensy 4 only).
+// Minor loop offsets land each 32-bit slot in its own buffer; update() converts whole blocks.
+//#define TDM_32_DMA_DEINTERLEAVE
+#define TDM_PROBE32_BLOCKS	64	// automatic channel mask: look for new connections every 64 blocks (~190 mS)
+#define I32_TO_F32_NORM_FACTOR (4.656612875245797e-10)   //which is 1/(2^31 - 1)
+
+#include "tdm_engine.h"
+
+// Low-latency callback, run in the transmit ISR every DMA period.
+// rx: the latest received sub-block, tx: the sub-block about to be sent (already holding the audio graph output).
+// Both are interleaved frames of TDM_CHANNELS int32 samples, as on the wire.
+typedef void (*tdm32_callback_t)(const int32_t *rx, int32_t *tx, int frames);
+
+// int32 blocks (setInt32() on the TDM_32 drivers): the F32 block's data array carries
+// the 32-bit TDM words unchanged, full scale +/- 2^31. Bit-transparent between TDM_32 endpoints;
+// AudioConvert_I32toF32 and AudioConvert_F32toI32 (convert_i32.h) connect them to float objects.
+typedef audio_block_f32_t audio_block_i32_t;
+static inline int32_t *tdm_i32(audio_block_i32_t *block) { return (int32_t *)block->data; }
+
+// TDM_32 format for the TDM engine: 8 x 32-bit slots on one data line, F32 or int32 blocks
+class tdm_format_32 : public AudioStream_F32
+{
+public:
+	typedef audio_block_f32_t block_t;
+	typedef uint8_t mask_t;
+	typedef int32_t slot_t;
+	static const int slots = TDM_CHANNELS;
+	static const int frame_words = TDM_CHANNELS;
+	static const int frames = TDM_32_DMA_FRAMES;
+	static const int tx_lines = 1;
+	static const int rx_lines = 1;
+	static const int group = 1;
+#if defined(TDM_32_DMA_DEINTERLEAVE)
+	static const bool deinterleave = true;
+#else
+	static const bool deinterleave = false;
+#endif
+	static const int probe_blocks = TDM_PROBE32_BLOCKS;
+	static const int meter_shift = 8;	// metered samples are 24-bit
+	static constexpr float meter_full = 8388608.0f;
+	static const int gain_steps = AUDIO_BLOCK_SAMPLES;	// kernels step per sample
+	tdm_format_32(unsigned char ninput, audio_block_f32_t **iqueue) : AudioStream_F32(ninput, iqueue) {}
+protected:
+	static audio_block_f32_t *allocate_block(void) { return allocate_f32(); }
+	template <int STRIDE>
+	static void unpack(audio_block_f32_t **blocks, const uint32_t *src, unsigned int offset, int frames, tdm_meter_acc *meter, tdm_gain *gain) {
+		if (blocks[0] && gain) {
+			if (meter)
+				unpack_32<STRIDE, true, true>(blocks[0], src, offset, frames, meter, gain);
+			else
+				unpack_32<STRIDE, false, true>(blocks[0], src, offset, frames, meter, gain);
+		} else if (meter)
+			unpack_32<STRIDE, true, false>(blocks[0], src, offset, frames, meter, gain);
+		else if (blocks[0])
+			unpack_32<STRIDE, false, false>(blocks[0], src, offset, frames, meter, gain);
+	}
+	// METER: words >> 8 go to the meter, with or without a block, before the gain.
+	// GAIN: int32 blocks are scaled with saturation; for float it joins the normalisation factor.
+	template <int STRIDE, bool METER, bool GAIN>
+	static void unpack_32(audio_block_f32_t *block, const uint32_t *src, unsigned int offset, int frames, tdm_meter_acc *meter, tdm_gain *gain) {
+		const float32_t norm = I32_TO_F32_NORM_FACTOR / TDM_GAIN_UNITY;
+		int32_t x, mx = 0, mn = 0;
+		uint64_t power = 0;
+		if (METER) {
+			mx = meter->max;
+			mn = meter->min;
+		}
+		if (block == nullptr) {
+			for (int j = 0; j < frames; j++)
+				tdm_meter_1((int32_t)src[j * STRIDE] >> 8, mx, mn, power);
+		} else if (int32_blocks) {
+			int32_t *d = tdm_i32(block) + offset;
+			for (int j = 0; j < frames; j++) {
+				x = src[j * STRIDE];
+				d[j] = GAIN ? tdm_gain_32(x, tdm_gain_next(*gain)) : x;
+				if (METER) tdm_meter_1(x >> 8, mx, mn, power);
+			}
+		} else {
+			float32_t *dest = block->data + offset;
+			for (int j = 0; j < frames; j++) {
+				x = src[j * STRIDE];
+				if (GAIN)
+					dest[j] = ((float32_t)x) * (norm * tdm_gain_next(*gain));
+				else
+					dest[j] = ((float32_t)x) * I32_TO_F32_NORM_FACTOR;
+				if (METER) tdm_meter_1(x >> 8, mx, mn, power);
+			}
+		}
+		if (METER) {
+			meter->max = mx;
+			meter->min = mn;
+			meter->power += power;
+		}
+	}
+	static void from_slots(const int32_t *src, audio_block_f32_t *block, tdm_gain *gain) {
+		if (gain) {
+			unpack_32<1, false, true>(block, (const uint32_t *)src, 0, AUDIO_BLOCK_SAMPLES, nullptr, gain);
+			return;
+		}
+		if (int32_blocks) {
+			memcpy(block->data, src, sizeof(block->data));
+			return;
+		}
+		for (int j = 0; j < AUDIO_BLOCK_SAMPLES; j++)
+			block->data[j] = ((float32_t)src[j]) * I32_TO_F32_NORM_FACTOR;
+	}
+	static bool int32_blocks;	// input blocks carry int32 samples
+};
+
 class AudioOutputTDM_32 : public AudioStream_F32
 {
 public: // 8 blocks of 32 bits
@@ -44,20 +162,38 @@ public: // 8 blocks of 32 bits
 	AudioOutputTDM_32(int sampleLength = 32, float sampleRate = 44100.0) : AudioStream_F32(8, inputQueueArray) { begin(sampleLength, sampleRate); }
 	virtual void update(void);
 	void begin(int sampleLength = 32, float sampleRate = 44100.0);
-	friend class AudioInputTDM_32;
 	uint32_t getTCR2(void) {return TCR2_val;}
 	uint32_t TCR2_val = 0x0505;
 
 	int getDMAbal(void);
+	typedef tdm_stats<TDM_CHANNELS> stats_t;
+	void getStats(stats_t &stats) { monitor.snapshot(stats); }
+	void resetStats(void) { monitor.reset(); }
+	void setCallback(tdm32_callback_t fn) { callback = fn; }
+	// Slot n sends channel map[n] (TDM_SLOT_MUTE: silence), from the next audio block
+	void setChannelMap(const int8_t *map = nullptr, int count = 0);
+	// true: input blocks carry int32 samples (audio_block_i32_t), sent without scaling
+	void setInt32(bool on) { int32_blocks = on; }
+	bool getInt32(void) { return int32_blocks; }
+	// Gain of channel n, ramped over one audio block: linear, negative inverts the polarity.
+	// Applied by update() while scaling, so it follows the channel, before the map.
+	void setSlotGain(int n, float gain) { gains.set(n, gain); }
+	float getSlotGain(int n) { return gains.get(n); }
+	// The scaling update() applies to each float block; static, so benchmarks can time it alone
+	static void scale_f32_to_i32(float32_t *p_f32, int32_t *p_i32, int len, tdm_gain *gain = nullptr);
 protected:
-	static void config_tdm(void);
-	static audio_block_f32_t *block_input[8];
 	static bool update_responsibility;
 	static DMAChannel dma;
 	static void isr(void);
-	void scale_f32_to_i32(float32_t *p_f32, int32_t *p_i32, int len);
 	static float sample_rate_Hz;
 	//static int audio_block_samples;
+	static tdm32_callback_t callback;
+	static bool int32_blocks;
+	static tdm_monitor<TDM_CHANNELS> monitor;
+	static volatile int dma_balance;
+	static int8_t tx_map[TDM_CHANNELS], tx_map_next[TDM_CHANNELS];
+	static volatile bool map_pending;
+	static tdm_gain_set<TDM_CHANNELS> gains;
 private:
 	audio_block_f32_t *inputQueueArray[8];
 };
@@ -34,22 +34,163 @@
 
 //#define SAMPLE_LENGTH	16	// or 32 for original CS42448
 
-class AudioOutputTDM_A : public AudioStream
+// DMA period in frames, for both TDM_A input and output: 16, 32, 64 or AUDIO_BLOCK_SAMPLES (default).
+// Below AUDIO_BLOCK_SAMPLES the receive ISR assembles audio blocks from sub-blocks and the transmit ISR
+// starts on new blocks at the next sub-block, cutting the round trip through the audio graph.
+#define TDM_A_DMA_FRAMES	AUDIO_BLOCK_SAMPLES
+
+// Codec word length: 16 (16 x 16-bit slots per line), or 24 / 32 (8 x 32-bit slots per line, one channel each).
+// Longer words are reduced to the int16 audio blocks inside the deinterleave loop, with TPDF dither
+// when TDM_A_DITHER is 1; output samples fill the top 16 bits of the word. Give the control object the same sampleLength.
+#define TDM_A_WORD_BITS		16
+#define TDM_A_DITHER		1
+#if TDM_A_WORD_BITS != 16 && TDM_A_WORD_BITS != 24 && TDM_A_WORD_BITS != 32
+#error "TDM_A_WORD_BITS must be 16, 24 or 32"
+#endif
+#define TDM_A_SLOTS			(TDM_A_WORD_BITS == 16 ? 16 : 8)	// channels per data line
+
+// SAI1 data lines, 16 x 16-bit slots each (Teensy 4 only above 1), or 8 x 32-bit.
+// TX_DATA0..3 are pins 7, 32, 9, 6; RX_DATA0..3 are pins 8, 6, 9, 32.
+// Pins 6, 9 and 32 are shared between transmit and receive, so with both directions in use
+// 2 + 2 lines (32 x 32 channels) is the symmetric maximum. 4 + 1 and 1 + 4 give 64 channels one way.
+#define TDM_A_TX_LINES		1
+#define TDM_A_RX_LINES		1
+#define TDM_A_TX_CHANNELS	(TDM_A_SLOTS * TDM_A_TX_LINES)
+#define TDM_A_RX_CHANNELS	(TDM_A_SLOTS * TDM_A_RX_LINES)
+#if TDM_A_TX_LINES < 1 || TDM_A_TX_LINES > 4 || TDM_A_RX_LINES < 1 || TDM_A_RX_LINES > 4
+#error "TDM_A_TX_LINES and TDM_A_RX_LINES must be 1 to 4"
+#endif
+#if (TDM_A_TX_LINES >= 2 && TDM_A_RX_LINES >= 4) || (TDM_A_TX_LINES >= 3 && TDM_A_RX_LINES >= 3) || (TDM_A_TX_LINES >= 4 && TDM_A_RX_LINES >= 2)
+#error "TDM_A_TX_LINES and TDM_A_RX_LINES need the same pin"
+#endif
+
+// Second TDM_A instance on SAI2 (Teensy 4): AudioInputTDM_A2 and AudioOutputTDM_A2, 16 channels each way.
+// TX_DATA on pin 2, RX_DATA on pin 5, BCLK pin 3, LRCLK pin 4, MCLK pin 33.
+//#define TDM_A_SAI2
+
+// Deinterleave in the eDMA instead of the ISR (Teensy 4 only).
+// Each 32-bit word is written as two 16-bit halves, each into its own slot buffer,
+// using minor loop offsets. The ISR only notes which buffer segment is complete.
+//#define TDM_A_DMA_DEINTERLEAVE
+#define TDM_PROBE_BLOCKS	64	// automatic channel mask: look for new connections every 64 blocks (~190 mS)
+
+#include "memcpy_tdm.h"
+#include "tdm_engine.h"
+
+// channel masks: one bit per channel, sized for the wider of the input and the output
+#if TDM_A_RX_LINES > 2 || TDM_A_TX_LINES > 2
+typedef uint64_t tdm_mask_t;
+#elif TDM_A_RX_LINES > 1 || TDM_A_TX_LINES > 1
+typedef uint32_t tdm_mask_t;
+#else
+typedef uint16_t tdm_mask_t;
+#endif
+
+// TDM_A format for the TDM engine: int16 blocks from 16 x 16-bit slots per data line,
+// or from 8 x 32-bit slots (TDM_A_WORD_BITS 24 or 32).
+class tdm_format_A : public AudioStream
 {
-public: // 16 x 16 bits
-	AudioOutputTDM_A(int sampleLength = 16) : AudioStream(16, inputQueueArray) { begin(sampleLength); }
-	virtual void update(void);
-	void begin(int sampleLength = 16);
-	friend class AudioInputTDM_A;
+public:
+	typedef audio_block_t block_t;
+	typedef tdm_mask_t mask_t;
+	static const bool wide = (TDM_A_WORD_BITS != 16);
+#if TDM_A_WORD_BITS == 16
+	typedef int16_t slot_t;
+#else
+	typedef int32_t slot_t;
+#endif
+	static const int slots = TDM_A_SLOTS;
+	static const int frame_words = TDM_A_FRAME_WORDS;
+	static const int frames = TDM_A_DMA_FRAMES;
+	static const int tx_lines = TDM_A_TX_LINES;
+	static const int rx_lines = TDM_A_RX_LINES;
+	static const int group = wide ? 1 : 2;	// slot pairs
+#if defined(TDM_A_DMA_DEINTERLEAVE)
+	static const bool deinterleave = true;
+#else
+	static const bool deinterleave = false;
+#endif
+	static const int probe_blocks = TDM_PROBE_BLOCKS;
+	static const int meter_shift = wide ? 16 : 0;	// metered samples are int16
+	static constexpr float meter_full = 32768.0f;
+	static const int gain_steps = AUDIO_BLOCK_SAMPLES / 2;	// kernels step per sample pair
+	tdm_format_A(unsigned char ninput, audio_block_t **iqueue) : AudioStream(ninput, iqueue) {}
+protected:
+	static audio_block_t *allocate_block(void) { return allocate(); }
+	// channels with no block (inactive, or allocation failed) are skipped, unless metered or scaled
+	template <int STRIDE>
+	static void unpack(audio_block_t **blocks, const uint32_t *src, unsigned int offset, int frames, tdm_meter_acc *meter, tdm_gain *gain) {
+		if (meter && gain)
+			unpack_group<STRIDE, true, true>(blocks, src, offset, frames, meter, gain);
+		else if (meter)
+			unpack_group<STRIDE, true, false>(blocks, src, offset, frames, meter, gain);
+		else if (gain)
+			unpack_group<STRIDE, false, true>(blocks, src, offset, frames, meter, gain);
+		else if (wide) {
+			if (blocks[0])
+				memcpy_tdm_rx_32to16<STRIDE>(blocks[0]->data + offset, src, dither_seed, TDM_A_DITHER, word_mask, frames);
+		} else if (blocks[0] && blocks[1])
+			memcpy_tdm_rx_16<STRIDE>(blocks[0]->data + offset, blocks[1]->data + offset, src, frames);
+		else if (blocks[0])
+			memcpy_tdm_rx_16_even<STRIDE>(blocks[0]->data + offset, src, frames);
+		else if (blocks[1])
+			memcpy_tdm_rx_16_odd<STRIDE>(blocks[1]->data + offset, src, frames);
+	}
+	// the whole group, a channel with no block into scratch
+	template <int STRIDE, bool METER, bool GAIN>
+	static void unpack_group(audio_block_t **blocks, const uint32_t *src, unsigned int offset, int frames, tdm_meter_acc *meter, tdm_gain *gain) {
+		int16_t *scratch = tdm_meter_scratch<AUDIO_BLOCK_SAMPLES>::data;
+		int16_t *dest = blocks[0] ? blocks[0]->data + offset : scratch;
+		if (wide)
+			memcpy_tdm_rx_32to16<STRIDE, METER, GAIN>(dest, src, dither_seed, TDM_A_DITHER, word_mask, frames, meter, gain);
+		else
+			memcpy_tdm_rx_16<STRIDE, METER, GAIN>(dest, blocks[1] ? blocks[1]->data + offset : scratch, src, frames, meter, gain);
+	}
+	static void from_slots(const slot_t *src, audio_block_t *block, tdm_gain *gain) {
+		if (wide && gain)
+			memcpy_tdm_rx_32to16<1, false, true>(block->data, (const uint32_t *)src, dither_seed, TDM_A_DITHER, word_mask,
+				AUDIO_BLOCK_SAMPLES, nullptr, gain);
+		else if (wide)
+			memcpy_tdm_rx_32to16<1>(block->data, (const uint32_t *)src, dither_seed, TDM_A_DITHER, word_mask);
+		else if (gain)
+			tdm_gain_copy16(block->data, (const int16_t *)src, AUDIO_BLOCK_SAMPLES, *gain);
+		else
+			memcpy(block->data, src, sizeof(block->data));
+	}
+	template <int STRIDE>
+	static void pack(uint32_t *dest, const uint32_t * const *src, int frames, tdm_gain *gain) {
+		if (wide && gain)
+			memcpy_tdm_tx_32<STRIDE, true>(dest, src[0], frames, gain);
+		else if (wide)
+			memcpy_tdm_tx_32<STRIDE>(dest, src[0], frames);
+		else if (gain)
+			memcpy_tdm_tx<STRIDE, true>(dest, src[0], src[1], frames, gain);
+		else
+			memcpy_tdm_tx<STRIDE>(dest, src[0], src[1], frames);
+	}
+	static const uint32_t word_mask = (TDM_A_WORD_BITS == 24) ? 0xFFFFFF00 : 0xFFFFFFFF;	// bits below a 24-bit word are undriven
+	static uint32_t dither_seed;
+};
+
+// AudioOutputTDM_A runs on SAI1; AudioOutputTDM_A2 on SAI2 with one data line (Teensy 4, TDM_A_SAI2).
+// Each has its own DMA channel, buffers and blocks.
+class AudioOutputTDM_A : public AudioOutputTDM_Engine<tdm_format_A, 1>
+{
+public:
+	AudioOutputTDM_A(int sampleLength = 16) { begin(sampleLength); }
+	void begin(int sampleLength = 16) { begin_engine(true); }
 	uint32_t getTCR2(void) {return TCR2_val;}
 	uint32_t TCR2_val = 0x0505;
-protected:
-	static void config_tdm(void);
-	static audio_block_t *block_input[16];
-	static bool update_responsibility;
-	static DMAChannel dma;
-	static void isr(void);
-private:
-	audio_block_t *inputQueueArray[16];
 };
+extern template class AudioOutputTDM_Engine<tdm_format_A, 1>;
+
+#if defined(TDM_A_SAI2)
+class AudioOutputTDM_A2 : public AudioOutputTDM_Engine<tdm_format_A, 2>
+{
+public:
+	AudioOutputTDM_A2(int sampleLength = 16) { begin(sampleLength); }
+	void begin(int sampleLength = 16) { begin_engine(true); }
+};
+extern template class AudioOutputTDM_Engine<tdm_format_A, 2>;
+#endif
 #endif
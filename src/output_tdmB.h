@@ -1,5 +1,5 @@
 /* Audio Library for Teensy 3.X
-*** BCLK INVERTED ***
+*** 16 x 32-bit slots, 16 bit samples in the upper half (RP)
  * Copyright (c) 2017, Paul Stoffregen, paul@pjrc.com
  *
  * Development of this audio library was funded by PJRC.COM, LLC by sales of
@@ -25,33 +25,82 @@
  * THE SOFTWARE.
  */
 
-#ifndef output_tdm_h_
-#define output_tdm_h_
+#ifndef output_tdmB_h_
+#define output_tdmB_h_
 
 #include <Arduino.h>     // github.com/PaulStoffregen/cores/blob/master/teensy4/Arduino.h
 #include <AudioStream.h> // github.com/PaulStoffregen/cores/blob/master/teensy4/AudioStream.h
 #include <DMAChannel.h>  // github.com/PaulStoffregen/cores/blob/master/teensy4/DMAChannel.h
+#include "memcpy_tdm.h"
+#include "tdm_engine.h"
 
 //#define SAMPLE_LENGTH	16	// or 32 for original CS42448
 
-class AudioOutputTDM_B : public AudioStream
+// SAI for the TDM_B input and output: 1, or 2 on Teensy 4 (pins as TDM_A_SAI2)
+#define TDM_B_SAI	1
+#define TDM_B_FRAME_WORDS	16	// 16 x 32-bit slots per frame
+
+// TDM_B format for the TDM engine: 16 x 32-bit slots on one data line, int16 blocks.
+// Each sample is the upper half of its slot; the lower half is sent as zero and ignored on receive.
+class tdm_format_B : public AudioStream
 {
 public:
-	AudioOutputTDM_B(bool BCLKrising = true, int sampleLength = 32) : AudioStream(16, inputQueueArray) { begin(BCLKrising, sampleLength); }
-	virtual void update(void);
-	void begin(bool BCLKrising = true, int sampleLength = 32);
-	friend class AudioInputTDM_B;
-	uint32_t getTCR2(void) {return TCR2_val;}
-	uint32_t TCR2_val = 0x0505;
+	typedef audio_block_t block_t;
+	typedef uint16_t mask_t;
+	typedef int32_t slot_t;
+	static const int slots = 16;
+	static const int frame_words = TDM_B_FRAME_WORDS;
+	static const int frames = AUDIO_BLOCK_SAMPLES;
+	static const int tx_lines = 1;
+	static const int rx_lines = 1;
+	static const int group = 1;
+	static const bool deinterleave = false;
+	static const int probe_blocks = 64;	// ~190 mS
+	static const int meter_shift = 16;	// metered samples are int16
+	static constexpr float meter_full = 32768.0f;
+	static const int gain_steps = AUDIO_BLOCK_SAMPLES / 2;	// kernels step per sample pair
+	tdm_format_B(unsigned char ninput, audio_block_t **iqueue) : AudioStream(ninput, iqueue) {}
 protected:
-	static void config_tdm(bool BCLKrising);
-	static audio_block_t *block_input[16];
-	static bool update_responsibility;
-	static DMAChannel dma;
-	static void isr(void);
-private:
-	audio_block_t *inputQueueArray[16];
+	static audio_block_t *allocate_block(void) { return allocate(); }
+	template <int STRIDE>
+	static void unpack(audio_block_t **blocks, const uint32_t *src, unsigned int offset, int frames, tdm_meter_acc *meter, tdm_gain *gain) {
+		int16_t *dest = blocks[0] ? blocks[0]->data + offset : tdm_meter_scratch<AUDIO_BLOCK_SAMPLES>::data;
+		if (meter && gain)
+			memcpy_tdm_rx_16_even<STRIDE, true, true>(dest, src, frames, meter, gain);
+		else if (meter)
+			memcpy_tdm_rx_16_even<STRIDE, true>(dest, src, frames, meter);
+		else if (gain)
+			memcpy_tdm_rx_16_even<STRIDE, false, true>(dest, src, frames, meter, gain);
+		else if (blocks[0])
+			memcpy_tdm_rx_16_even<STRIDE>(dest, src, frames);
+	}
+	static void from_slots(const int32_t *src, audio_block_t *block, tdm_gain *gain) {
+		if (gain) {
+			for (int j = 0; j < AUDIO_BLOCK_SAMPLES; j++)
+				block->data[j] = tdm_gain_32(src[j], (j & 1) ? gain->now : tdm_gain_next(*gain)) >> 16;
+			return;
+		}
+		for (int j = 0; j < AUDIO_BLOCK_SAMPLES; j++)
+			block->data[j] = src[j] >> 16;
+	}
+	template <int STRIDE>
+	static void pack(uint32_t *dest, const uint32_t * const *src, int frames, tdm_gain *gain) {
+		if (gain)
+			memcpy_tdm_tx_32<STRIDE, true>(dest, src[0], frames, gain);
+		else
+			memcpy_tdm_tx_32<STRIDE>(dest, src[0], frames);
+	}
 };
 
+// BCLKrising: codecs sample data on the rising edge of BCLK
+class AudioOutputTDM_B : public AudioOutputTDM_Engine<tdm_format_B, TDM_B_SAI>
+{
+public:
+	AudioOutputTDM_B(bool BCLKrising = true, int sampleLength = 32) { begin(BCLKrising, sampleLength); }
+	void begin(bool BCLKrising = true, int sampleLength = 32) { begin_engine(BCLKrising); }
+	uint32_t getTCR2(void) {return TCR2_val;}
+	uint32_t TCR2_val = 0x0505;
+};
+extern template class AudioOutputTDM_Engine<tdm_format_B, TDM_B_SAI>;
 
 #endif
@@ -0,0 +1,918 @@
+/* TDM driver engine
+ * One implementation of the TDM input and output drivers, instantiated per format and SAI.
+ *
+ * A format is the AudioStream base of a driver: it names the block and mask types,
+ * the frame layout and DMA options, and supplies the packing kernels at compile time.
+ * tdm_format_A (output_tdmA.h): 16 x 16-bit slots per line, int16 blocks
+ * tdm_format_B (output_tdmB.h): 16 x 32-bit slots, int16 blocks in the upper halves
+ * tdm_format_32 (output_tdm32.h): 8 x 32-bit slots, F32 blocks
+ *
+ * Format members used here:
+ *   block_t, mask_t, slot_t         block, channel mask and DMA deinterleave sample types
+ *   slots, frame_words              slots and 32-bit words per frame on one data line
+ *   frames                          DMA period in frames
+ *   tx_lines, rx_lines              data lines on SAI1 (other SAIs have one)
+ *   group                           channels handled by one kernel call: 2 for paired 16-bit slots
+ *   deinterleave, probe_blocks      DMA deinterleave, automatic mask probe period
+ *   allocate_block()                allocate() or allocate_f32()
+ *   unpack<STRIDE>(blocks, src, offset, frames, meter, gain)   one group from interleaved frames to blocks,
+ *                                   metered into meter[0..group-1] unless meter is null,
+ *                                   scaled by gain[0..group-1] unless gain is null
+ *   meter_shift, meter_full         metered sample from a DMA deinterleave slot_t, and its full scale
+ *   gain_steps                      gain ramp steps per audio block taken by the kernels
+ *   from_slots(src, block, gain)    one DMA deinterleave slot buffer to a block
+ *   pack<STRIDE>(dest, src, frames, gain)   one group from blocks to interleaved frames (output, int16 formats)
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef _tdm_engine_h_
+#define _tdm_engine_h_
+
+#include <Arduino.h>
+#include <DMAChannel.h>
+#include "tdm_sai.h"
+#include "memcpy_tdm.h"
+#include "tdm_stats.h"
+#include "tdm_meter.h"
+#include "tdm_gain.h"
+#include "tdm_profile.h"
+
+// setFallback(): what an active channel transmits when its block could not be allocated
+#define TDM_FALLBACK_NONE	0	// nothing: receivers see a missing block (silence for most objects)
+#define TDM_FALLBACK_ZERO	1	// a held silent block
+#define TDM_FALLBACK_REPEAT	2	// the channel's previous block again (holds one extra block per active channel)
+
+// Low-latency callback, run in the transmit ISR every DMA period.
+// rx: the latest received sub-block, tx: the sub-block about to be sent (already holding the audio graph output).
+// Both are interleaved frames as on the wire: see tdm_a_get() and tdm_a_put() in memcpy_tdm.h.
+typedef void (*tdm_callback_t)(const uint32_t *rx, uint32_t *tx, int frames);
+
+// Receive tap, run in the receive ISR every DMA period with the half buffer just received:
+// interleaved frames as on the wire, stride words each. Not called with DMA deinterleave.
+typedef void (*tdm_rx_callback_t)(const uint32_t *rx, int frames);
+
+#define TDM_RX_SEGMENTS		3	// DMA deinterleave: blocks per slot buffer (one filling, one complete, one spare)
+
+// setChannelMap(): an entry that mutes its channel (input) or slot (output)
+#define TDM_SLOT_MUTE		(-1)
+
+// Fill a channel map of n entries from map[0..count-1]: entries past count keep their own slot,
+// out of range entries mute.
+static inline void tdm_map_fill(int8_t *dest, int n, const int8_t *map, int count)
+{
+	for (int i = 0; i < n; i++)
+		dest[i] = (i >= count) ? i : (map[i] >= 0 && map[i] < n) ? map[i] : TDM_SLOT_MUTE;
+}
+
+template <class F, int SAI>
+class AudioInputTDM_Engine : public F
+{
+public:
+	typedef typename F::block_t block_t;
+	typedef typename F::mask_t mask_t;
+	typedef typename F::slot_t slot_t;
+	static const int lines = (SAI == 1) ? F::rx_lines : 1;
+	static const int channels = F::slots * lines;
+	static const int stride = F::frame_words * lines;	// words per frame
+
+	AudioInputTDM_Engine(void) : F(0, NULL) {}
+	virtual void update(void);
+	// Only channels in the mask are allocated, filled and transmitted.
+	// Default is automatic: channels with no connection are dropped and are re-checked every probe_blocks.
+	void setActiveChannels(mask_t mask);
+	void setActiveChannels(void);	// back to automatic
+	mask_t getActiveChannels(void) { return active_mask; }
+	// Under memory pressure blocks are allocated in priority order: listed channels first, then the rest.
+	void setPriority(const uint8_t *list, int count);
+	void setFallback(int mode) { fallback = mode; }
+	// Channel n takes slot map[n] (TDM_SLOT_MUTE: nothing). Several channels may share a slot:
+	// they are sent the same block. Takes effect at the next update(); no map = slot order.
+	void setChannelMap(const int8_t *map = nullptr, int count = 0);
+	uint32_t getDropouts(int channel);	// blocks missed by a channel
+	void resetDropouts(void);
+	int getDMAbal(void) { return dma_balance; }	// -1, 0 or +1 while the DMA halves alternate
+	typedef tdm_stats<channels> stats_t;
+	void getStats(stats_t &stats) { monitor.snapshot(stats); }
+	void resetStats(void) { monitor.reset(); }
+	// Fused metering of every channel, active or not, as it is deinterleaved.
+	// Levels are full scale 1.0 and follow the channel map. getMeters() copies the latest
+	// count levels without blocking the ISR: call it from loop().
+	void setMetering(bool on);
+	void setMeterBallistics(float release_ms = TDM_METER_RELEASE, float rms_ms = TDM_METER_RMS);
+	int getMeters(tdm_meter_t *levels, int count = channels);
+	// Gain of a slot, before the channel map: linear, negative inverts the polarity.
+	// Applied in the deinterleave kernels and ramped over one audio block.
+	void setSlotGain(int slot, float gain) { gains.set(slot, gain); }
+	float getSlotGain(int slot) { return gains.get(slot); }
+	// Receive tap, e.g. for a recorder that stores the frames as they are: keep it short.
+	void setRxCallback(tdm_rx_callback_t fn) { rx_callback = fn; }
+protected:
+	void begin_engine(bool bclk_rising);
+	static bool update_responsibility;
+	static DMAChannel dma;
+	static void isr(void);
+private:
+	static tdm_rx_callback_t rx_callback;
+	static void allocate_blocks(block_t **blocks, mask_t mask);
+	void transmit_blocks(block_t **blocks, mask_t wanted);
+	static unsigned int slot_channel(unsigned int n);
+	static void rx_done(uint32_t start, int half);
+	static mask_t slot_mask(void);
+	static void meter_period(int frames);
+	static void meter_coefs(void);
+	// blocks are held by slot; channels are mapped onto them when transmitted
+	static block_t *block_incoming[channels];
+	static mask_t active_mask;	// by channel; the other masks are by slot
+	static bool auto_mask;
+	static uint8_t probe_count;
+	static mask_t incoming_mask;
+	static uint8_t alloc_order[channels];
+	static int8_t in_map[channels];	// slot for each channel, read only by update()
+	static uint8_t fallback;
+	static tdm_monitor<channels> monitor;	// null_blocks: dropouts
+	static block_t *last_block[channels];
+	static block_t *silence;
+	static volatile int dma_balance;
+	// low latency DMA period (frames < AUDIO_BLOCK_SAMPLES)
+	static block_t *block_ready[channels];	// complete, waiting for update()
+	static block_t *block_next[channels];	// allocated by update(), waiting for the ISR
+	static mask_t ready_mask, next_mask;
+	static volatile bool ready_valid, next_valid;
+	static uint32_t rx_offset;	// frames of block_incoming filled
+	// DMA buffers: interleaved frames, or one buffer per slot for DMA deinterleave
+	static uint32_t rx_buffer[F::deinterleave ? 1 : F::frames*2*stride]; // two sets of frames
+	static slot_t rx_slots[F::deinterleave ? channels : 1][F::deinterleave ? AUDIO_BLOCK_SAMPLES*TDM_RX_SEGMENTS : 1];
+	static DMASetting tcd[F::deinterleave ? TDM_RX_SEGMENTS : 1];
+	static volatile int8_t segment_ready;
+	// metering, by slot: meter_seq is odd while the levels change
+	static bool metering;
+	static float release_time, rms_time;	// mS, from setMeterBallistics()
+	static float peak_decay, rms_coef;	// for meter_fs: recomputed when the sample rate changes
+	static int meter_fs;
+	static tdm_meter_acc meter_acc[channels];
+	static tdm_meter_t meters[channels];
+	static volatile uint32_t meter_seq;
+	static tdm_gain_set<channels> gains;	// by slot
+};
+
+// Output engine for the int16 formats
+template <class F, int SAI>
+class AudioOutputTDM_Engine : public F
+{
+public:
+	typedef typename F::block_t block_t;
+	typedef typename F::mask_t mask_t;
+	static const int lines = (SAI == 1) ? F::tx_lines : 1;
+	static const int channels = F::slots * lines;
+	static const int stride = F::frame_words * lines;	// words per frame
+
+	AudioOutputTDM_Engine(void) : F(channels, inputQueueArray) {}
+	virtual void update(void);
+	uint32_t getISRcycles(void) { return monitor.cycles_last; }	// CPU cycles used by the last transmit ISR
+	uint32_t getISRcyclesMax(void) { return monitor.cycles_max; }
+	typedef tdm_stats<channels> stats_t;
+	void getStats(stats_t &stats) { monitor.snapshot(stats); }
+	void resetStats(void) { monitor.reset(); }
+	void setCallback(tdm_callback_t fn) { callback = fn; }
+	// Slot n sends channel map[n] (TDM_SLOT_MUTE: silence). One channel may feed several slots.
+	// Takes effect at the start of the next audio block; no map = slot order.
+	void setChannelMap(const int8_t *map = nullptr, int count = 0);
+	// Gain of a slot, after the channel map: linear, negative inverts the polarity.
+	// Applied in the interleave kernels and ramped over one audio block.
+	void setSlotGain(int slot, float gain) { gains.set(slot, gain); }
+	float getSlotGain(int slot) { return gains.get(slot); }
+protected:
+	void begin_engine(bool bclk_rising);
+	static block_t *block_input[channels];
+	static bool update_responsibility;
+	static DMAChannel dma;
+	static void isr(void);
+	static tdm_callback_t callback;
+	// low latency DMA period (frames < AUDIO_BLOCK_SAMPLES)
+	static block_t *block_next[channels];
+	static volatile bool next_valid;
+	static uint32_t tx_offset;	// frames of block_input sent; AUDIO_BLOCK_SAMPLES = none in hand
+	static uint32_t sub_count;
+	static uint32_t tx_buffer[F::frames*2*stride]; // two sets of frames
+	static uint32_t tx_silent[2]; // per half buffer: one bit per group already holding zeros
+	static tdm_monitor<channels> monitor;	// null_blocks: a channel's block missing after it had one
+	static mask_t fed;	// channels that had a block at the last update()
+	static const uint32_t zeros[AUDIO_BLOCK_SAMPLES/2]; // stands in for a missing block of a group
+	static int8_t tx_map[channels], tx_map_next[channels];	// channel for each slot
+	static volatile bool map_pending;
+	static tdm_gain_set<channels> gains;	// by slot
+private:
+	block_t *inputQueueArray[channels];
+};
+
+/********************************* input **********************************/
+
+#define TDM_IN	AudioInputTDM_Engine<F, SAI>
+
+template <class F, int SAI> bool TDM_IN::update_responsibility = false;
+template <class F, int SAI> DMAChannel TDM_IN::dma(false);
+template <class F, int SAI> typename F::block_t * TDM_IN::block_incoming[TDM_IN::channels];
+template <class F, int SAI> typename F::mask_t TDM_IN::active_mask = (typename F::mask_t)~0;
+template <class F, int SAI> bool TDM_IN::auto_mask = true;
+template <class F, int SAI> tdm_rx_callback_t TDM_IN::rx_callback = nullptr;
+template <class F, int SAI> uint8_t TDM_IN::probe_count = 0;
+template <class F, int SAI> typename F::mask_t TDM_IN::incoming_mask = 0;
+template <class F, int SAI> uint8_t TDM_IN::alloc_order[TDM_IN::channels];	// set by begin_engine()
+template <class F, int SAI> int8_t TDM_IN::in_map[TDM_IN::channels];	// set by begin_engine()
+template <class F, int SAI> uint8_t TDM_IN::fallback = TDM_FALLBACK_NONE;
+template <class F, int SAI> tdm_monitor<TDM_IN::channels> TDM_IN::monitor;
+template <class F, int SAI> typename F::block_t * TDM_IN::last_block[TDM_IN::channels];
+template <class F, int SAI> typename F::block_t * TDM_IN::silence = nullptr;
+template <class F, int SAI> volatile int TDM_IN::dma_balance = 0;
+template <class F, int SAI> typename F::block_t * TDM_IN::block_ready[TDM_IN::channels];
+template <class F, int SAI> typename F::block_t * TDM_IN::block_next[TDM_IN::channels];
+template <class F, int SAI> typename F::mask_t TDM_IN::ready_mask = 0;
+template <class F, int SAI> typename F::mask_t TDM_IN::next_mask = 0;
+template <class F, int SAI> volatile bool TDM_IN::ready_valid = false;
+template <class F, int SAI> volatile bool TDM_IN::next_valid = false;
+template <class F, int SAI> uint32_t TDM_IN::rx_offset;
+template <class F, int SAI> DMAMEM __attribute__((aligned(32)))
+uint32_t TDM_IN::rx_buffer[F::deinterleave ? 1 : F::frames*2*TDM_IN::stride];
+template <class F, int SAI> DMAMEM __attribute__((aligned(32)))
+typename F::slot_t TDM_IN::rx_slots[F::deinterleave ? TDM_IN::channels : 1][F::deinterleave ? AUDIO_BLOCK_SAMPLES*TDM_RX_SEGMENTS : 1];
+template <class F, int SAI> DMASetting TDM_IN::tcd[F::deinterleave ? TDM_RX_SEGMENTS : 1];
+template <class F, int SAI> volatile int8_t TDM_IN::segment_ready = -1;
+template <class F, int SAI> bool TDM_IN::metering = false;
+template <class F, int SAI> float TDM_IN::release_time;
+template <class F, int SAI> float TDM_IN::rms_time;
+template <class F, int SAI> float TDM_IN::peak_decay;
+template <class F, int SAI> float TDM_IN::rms_coef;
+template <class F, int SAI> int TDM_IN::meter_fs;
+template <class F, int SAI> tdm_meter_acc TDM_IN::meter_acc[TDM_IN::channels];
+template <class F, int SAI> tdm_meter_t TDM_IN::meters[TDM_IN::channels];
+template <class F, int SAI> volatile uint32_t TDM_IN::meter_seq = 0;
+template <class F, int SAI> tdm_gain_set<TDM_IN::channels> TDM_IN::gains;
+
+template <class F, int SAI>
+void TDM_IN::begin_engine(bool bclk_rising)
+{
+	for (int i = 0; i < channels; i++) {
+		alloc_order[i] = i;
+	}
+	tdm_map_fill(in_map, channels, nullptr, 0);
+	tdm_cycles_start(); // for the ISR stats
+	dma.begin(true); // Allocate the DMA channel first
+
+	// TODO: should we set & clear the I2S_RCSR_SR bit here?
+	tdm_config<SAI>(F::frame_words, AudioOutputTDM_Engine<F, SAI>::lines, lines, bclk_rising);
+#if defined(__IMXRT1062__)
+	if (F::deinterleave) {
+		// Minor loop = one frame: each word read from RDR0..RDRn is written as slot_t samples,
+		// DOFF apart, through the slot buffers. 16-bit slots: the low half (odd slot) is written first.
+		// With more than one line, SMOD wraps the source over the RDR registers.
+		// MLOFF returns to slot buffer 0, one sample on. Each segment TCD links to the next.
+		tdm_sai<SAI>::rx_pins(lines);
+		for (int seg = 0; seg < TDM_RX_SEGMENTS; seg++) {
+			tcd[seg].TCD->SADDR = &tdm_sai<SAI>::regs().RDR[0];
+			tcd[seg].TCD->SOFF = (lines > 1) ? 4 : 0;
+			tcd[seg].TCD->ATTR = DMA_TCD_ATTR_SSIZE(2) | DMA_TCD_ATTR_DSIZE(sizeof(slot_t) == 2 ? 1 : 2)
+				| ((lines > 1) ? DMA_TCD_ATTR_SMOD(lines == 4 ? 4 : 3) : 0);
+			tcd[seg].TCD->NBYTES_MLOFFYES = DMA_TCD_NBYTES_DMLOE
+				| DMA_TCD_NBYTES_MLOFFYES_MLOFF((int)sizeof(slot_t) - channels * (int)sizeof(rx_slots[0]))
+				| DMA_TCD_NBYTES_MLOFFYES_NBYTES(stride * 4);
+			tcd[seg].TCD->SLAST = 0;
+			tcd[seg].TCD->DADDR = &rx_slots[0][seg * AUDIO_BLOCK_SAMPLES];
+			tcd[seg].TCD->DOFF = sizeof(rx_slots[0]);
+			tcd[seg].TCD->CITER_ELINKNO = AUDIO_BLOCK_SAMPLES;
+			tcd[seg].TCD->BITER_ELINKNO = AUDIO_BLOCK_SAMPLES;
+			tcd[seg].TCD->CSR = 0;
+			tcd[seg].replaceSettingsOnCompletion(tcd[(seg + 1) % TDM_RX_SEGMENTS]);
+			tcd[seg].interruptAtCompletion();
+		}
+		dma = tcd[0];
+		dma.triggerAtHardwareEvent(tdm_sai<SAI>::dmamux_rx);
+	} else
+#endif
+	tdm_dma_rx<SAI>(dma, rx_buffer, sizeof(rx_buffer), lines);
+	update_responsibility = this->update_setup();
+	dma.enable();
+
+	tdm_start_rx<SAI>();
+	dma.attachInterrupt(isr);
+}
+
+template <class F, int SAI>
+void TDM_IN::setActiveChannels(mask_t mask)
+{
+	auto_mask = false;
+	active_mask = mask;
+}
+
+template <class F, int SAI>
+void TDM_IN::setActiveChannels(void)
+{
+	probe_count = 0;
+	auto_mask = true;
+	active_mask = ~(mask_t)0; // first block transmitted finds the connected channels
+}
+
+// Channels listed are allocated first, the rest follow in channel order
+template <class F, int SAI>
+void TDM_IN::setPriority(const uint8_t *list, int count)
+{
+	uint8_t order[channels];
+	mask_t listed = 0;
+	int i, n = 0;
+
+	for (i = 0; i < count; i++) {
+		if (list[i] >= channels || (listed & ((mask_t)1 << list[i]))) continue;
+		listed |= (mask_t)1 << list[i];
+		order[n++] = list[i];
+	}
+	for (i = 0; i < channels; i++) {
+		if (!(listed & ((mask_t)1 << i))) order[n++] = i;
+	}
+	__disable_irq();
+	memcpy(alloc_order, order, sizeof(alloc_order));
+	__enable_irq();
+}
+
+// update() runs at a lower priority than loop() can reach, so with interrupts off
+// the map changes between two updates, for whole blocks.
+template <class F, int SAI>
+void TDM_IN::setChannelMap(const int8_t *map, int count)
+{
+	int8_t next[channels];
+
+	tdm_map_fill(next, channels, map, count);
+	__disable_irq();
+	memcpy(in_map, next, sizeof(in_map));
+	__enable_irq();
+}
+
+template <class F, int SAI>
+void TDM_IN::setMetering(bool on)
+{
+	if (on && !metering) {
+		setMeterBallistics(); // also clears the levels
+	}
+	metering = on;
+}
+
+// Time constants: peak release and RMS integration, in mS. They hold across setSampleRate().
+template <class F, int SAI>
+void TDM_IN::setMeterBallistics(float release_ms, float rms_ms)
+{
+	__disable_irq();
+	release_time = release_ms;
+	rms_time = rms_ms;
+	meter_coefs();
+	meter_seq++;
+	for (int i = 0; i < channels; i++) {
+		meter_acc[i] = tdm_meter_acc();
+		meters[i].peak = meters[i].power = 0;
+		meters[i].clips = 0;
+	}
+	meter_seq++;
+	__enable_irq();
+}
+
+// Lock-free: copy again if the ISR updated the levels meanwhile
+template <class F, int SAI>
+int TDM_IN::getMeters(tdm_meter_t *levels, int count)
+{
+	uint32_t seq;
+	int i, slot;
+
+	if (count > channels) count = channels;
+	do {
+		seq = meter_seq;
+		asm volatile ("" ::: "memory");
+		for (i = 0; i < count; i++) {
+			slot = in_map[i];
+			if (slot >= 0) {
+				levels[i] = meters[slot];
+			} else {
+				levels[i].peak = levels[i].power = 0;
+				levels[i].clips = 0;
+			}
+		}
+		asm volatile ("" ::: "memory");
+	} while ((seq & 1) || seq != meter_seq);
+	return count;
+}
+
+// Per period coefficients for the time constants. Periods are DMA periods at the current sample rate.
+template <class F, int SAI>
+void TDM_IN::meter_coefs(void)
+{
+	float period = (float)(F::deinterleave ? AUDIO_BLOCK_SAMPLES : F::frames) / tdm_fs();
+
+	peak_decay = (release_time > 0) ? expf(-period * 1000.0f / release_time) : 0.0f;
+	rms_coef = (rms_time > 0) ? 1.0f - expf(-period * 1000.0f / rms_time) : 1.0f;
+	meter_fs = tdm_fs();
+}
+
+// End of a metering period: ballistics for every slot
+template <class F, int SAI>
+void TDM_IN::meter_period(int frames)
+{
+	if (meter_fs != tdm_fs()) meter_coefs(); // the sample rate changed
+	meter_seq++;
+	asm volatile ("" ::: "memory");
+	for (unsigned int i = 0; i < channels; i++)
+		tdm_meter_finish(meter_acc[i], meters[i], frames, F::meter_full, peak_decay, rms_coef);
+	asm volatile ("" ::: "memory");
+	meter_seq++;
+}
+
+// Slots feeding the active channels: the blocks to allocate
+template <class F, int SAI>
+typename F::mask_t TDM_IN::slot_mask(void)
+{
+	mask_t mask = 0;
+
+	for (unsigned int i = 0; i < channels; i++) {
+		if ((active_mask & ((mask_t)1 << i)) && in_map[i] >= 0)
+			mask |= (mask_t)1 << in_map[i];
+	}
+	return mask;
+}
+
+template <class F, int SAI>
+uint32_t TDM_IN::getDropouts(int channel)
+{
+	if (channel < 0 || channel >= channels) return 0;
+	return monitor.null_blocks[channel];
+}
+
+template <class F, int SAI>
+void TDM_IN::resetDropouts(void)
+{
+	__disable_irq();
+	memset((void *)monitor.null_blocks, 0, sizeof(monitor.null_blocks));
+	__enable_irq();
+}
+
+// allocate a block for each channel in mask, in priority order.
+// Stops at the first failure: the pool is empty, so lower priority channels miss out.
+template <class F, int SAI>
+void TDM_IN::allocate_blocks(block_t **blocks, mask_t mask)
+{
+	unsigned int n, i;
+
+	memset(blocks, 0, sizeof(block_t *) * channels);
+	for (n=0; n < channels; n++) {
+		i = alloc_order[n];
+		if (!(mask & ((mask_t)1 << i))) continue;
+		blocks[i] = F::allocate_block();
+		if (blocks[i] == nullptr) break;
+	}
+	for (; n < channels; n++) { // this one and every wanted channel after it
+		if (mask & ((mask_t)1 << alloc_order[n])) monitor.alloc_fails++;
+	}
+}
+
+// blocks: by slot, wanted: the slots blocks were allocated for.
+// Each channel is sent the block of its slot; any that missed get the fallback block.
+// transmit() only takes a reference for each connection it queues the block on,
+// so a ref_count unchanged afterwards means nothing is connected to that channel.
+template <class F, int SAI>
+void TDM_IN::transmit_blocks(block_t **blocks, mask_t wanted)
+{
+	unsigned int i;
+	mask_t connected = 0, sent = 0;
+	int refs, slot;
+	bool want;
+	block_t *block, *probe;
+
+	// held blocks are only changed here, in update()
+	if (fallback == TDM_FALLBACK_ZERO && silence == nullptr) {
+		silence = F::allocate_block();
+		if (silence) memset(silence->data, 0, sizeof(silence->data));
+	} else if (fallback != TDM_FALLBACK_ZERO && silence != nullptr) {
+		F::release(silence);
+		silence = nullptr;
+	}
+	for (i=0; i < channels; i++) {
+		slot = in_map[i];
+		want = slot >= 0 && (wanted & ((mask_t)1 << slot));
+		block = want ? blocks[slot] : nullptr;
+		if (!want || fallback != TDM_FALLBACK_REPEAT) {
+			if (last_block[i]) {
+				F::release(last_block[i]);
+				last_block[i] = nullptr;
+			}
+		}
+		if (!want) continue;
+		if (block == nullptr) {
+			monitor.null_blocks[i]++;
+			if (fallback == TDM_FALLBACK_ZERO) block = silence;
+			else if (fallback == TDM_FALLBACK_REPEAT) block = last_block[i];
+			if (block == nullptr) continue;
+			// fallback blocks stay held
+			refs = block->ref_count;
+			this->transmit(block, i);
+			if (block->ref_count != refs) connected |= (mask_t)1 << i;
+			sent |= (mask_t)1 << i;
+			continue;
+		}
+		sent |= (mask_t)1 << i;
+		refs = block->ref_count;
+		this->transmit(block, i);
+		if (block->ref_count != refs) connected |= (mask_t)1 << i;
+		if (fallback == TDM_FALLBACK_REPEAT) {
+			if (last_block[i]) F::release(last_block[i]);
+			block->ref_count++;	// held for the channel's next miss
+			last_block[i] = block;
+		}
+	}
+	// a slot's block may have gone to several channels: release it once they all have it
+	for (i=0; i < channels; i++) {
+		if (blocks[i]) F::release(blocks[i]);
+	}
+	if (!auto_mask) return;
+	if (++probe_count >= F::probe_blocks) {
+		// one shared silent block looks for new connections on the dropped channels
+		probe_count = 0;
+		probe = F::allocate_block();
+		if (probe) {
+			memset(probe->data, 0, sizeof(probe->data));
+			for (i=0; i < channels; i++) {
+				if (sent & ((mask_t)1 << i)) continue;
+				refs = probe->ref_count;
+				this->transmit(probe, i);
+				if (probe->ref_count != refs) connected |= (mask_t)1 << i;
+			}
+			F::release(probe);
+		}
+	} else if (!sent) {
+		return;
+	}
+	active_mask = (active_mask & ~sent) | connected;
+}
+
+// DMA deinterleave: channel held by slot buffer n.
+// Each word of a frame fills 4 / sizeof(slot_t) buffers, low half first; lines are interleaved word by word.
+template <class F, int SAI>
+unsigned int TDM_IN::slot_channel(unsigned int n)
+{
+	const unsigned int per_word = 4 / sizeof(slot_t);
+	unsigned int word = n / per_word;
+	unsigned int line = word % lines;
+	unsigned int slot = (word / lines) * per_word + (per_word - 1 - n % per_word);
+	return line * F::slots + slot;
+}
+
+template <class F, int SAI>
+void TDM_IN::isr(void)
+{
+	uint32_t daddr;
+	const uint32_t *src, *frame;
+	unsigned int i, offset = 0;
+	int seg, half;
+	tdm_gain *gain;
+	uint32_t start = ARM_DWT_CYCCNT;
+	TDM_PROFILE_SCOPE("TDM in isr", SAI);
+
+	daddr = (uint32_t)(dma.TCD->DADDR);
+	dma.clearInterrupt();
+
+	if (F::deinterleave) {
+		// DADDR is in the segment now being filled; the one before it is complete
+		seg = ((daddr - (uint32_t)rx_slots) % sizeof(rx_slots[0])) / (AUDIO_BLOCK_SAMPLES * sizeof(slot_t));
+		segment_ready = (seg + TDM_RX_SEGMENTS - 1) % TDM_RX_SEGMENTS;
+		if (update_responsibility) F::update_all();
+		// the completed segment is read by update(): late only if the DMA has skipped one
+		monitor.isr_done(start, seg, -1, TDM_RX_SEGMENTS);
+		return;
+	}
+
+	if (daddr < (uint32_t)rx_buffer + sizeof(rx_buffer) / 2) {
+		// DMA is receiving to the first half of the buffer
+		// need to remove data from the second half
+		src = &rx_buffer[F::frames*stride];
+		half = 1;
+		dma_balance++;
+	} else {
+		// DMA is receiving to the second half of the buffer
+		// need to remove data from the first half
+		src = &rx_buffer[0];
+		half = 0;
+		dma_balance--;
+	}
+	#if IMXRT_CACHE_ENABLED >=1
+	arm_dcache_delete((void*)src, sizeof(rx_buffer) / 2);
+	#endif
+	tdm_rx_latest<SAI>::buffer = src; // for the low-latency callback
+	if (rx_callback) rx_callback(src, F::frames);
+	frame = src;
+	if (F::frames < AUDIO_BLOCK_SAMPLES)
+		offset = rx_offset;
+	// channels with no block (inactive, or allocation failed) are skipped by the kernels
+	for (i=0; i < channels; i += F::group) {
+		// group's word, then data line
+		src = frame + ((i % F::slots) * F::frame_words / F::slots) * lines + (i / F::slots);
+		gain = nullptr;
+		if (gains.used && (block_incoming[i] || (F::group > 1 && block_incoming[i + F::group - 1])))
+			gain = gains.group(i, F::group, F::gain_steps);
+		F::template unpack<stride>(&block_incoming[i], src, offset, F::frames, metering ? &meter_acc[i] : nullptr, gain);
+	}
+	if (metering) meter_period(F::frames);
+	if (F::frames < AUDIO_BLOCK_SAMPLES) {
+		rx_offset += F::frames;
+		if (rx_offset < AUDIO_BLOCK_SAMPLES) {
+			rx_done(start, half);
+			return;
+		}
+		// blocks complete: hand them to update() and start on the ones it allocated
+		rx_offset = 0;
+		if (ready_valid) {
+			for (i=0; i < channels; i++) { // update() missed them
+				if (block_ready[i]) F::release(block_ready[i]);
+			}
+		}
+		memcpy(block_ready, block_incoming, sizeof(block_ready));
+		ready_mask = incoming_mask;
+		ready_valid = true;
+		if (next_valid) {
+			memcpy(block_incoming, block_next, sizeof(block_incoming));
+			incoming_mask = next_mask;
+			next_valid = false;
+		} else {
+			memset(block_incoming, 0, sizeof(block_incoming));
+			incoming_mask = 0;
+		}
+	}
+	if (update_responsibility) F::update_all();
+	rx_done(start, half);
+}
+
+// The half just read must not have been reached by the DMA again
+template <class F, int SAI>
+void TDM_IN::rx_done(uint32_t start, int half)
+{
+	uint32_t daddr = (uint32_t)(dma.TCD->DADDR);
+	monitor.isr_done(start, half, daddr < (uint32_t)rx_buffer + sizeof(rx_buffer) / 2 ? 0 : 1);
+}
+
+template <class F, int SAI>
+void TDM_IN::update(void)
+{
+	block_t *new_block[channels];
+	block_t *out_block[channels];
+	mask_t new_mask = 0, out_mask = 0;
+	unsigned int i;
+	int seg;
+	TDM_PROFILE_SCOPE("TDM in update", SAI);
+
+	if (F::deinterleave) {
+		// The completed segment stays untouched for another block while DMA fills the next one,
+		// so it can be copied out here rather than in the ISR.
+		seg = segment_ready;
+		if (seg < 0) return;
+		segment_ready = -1;
+
+		new_mask = slot_mask();
+		allocate_blocks(new_block, new_mask);
+		for (i=0; i < channels; i++) {
+			block_t *block = new_block[slot_channel(i)];
+			if (block == nullptr && !metering) continue;
+			const slot_t *src = &rx_slots[i][seg * AUDIO_BLOCK_SAMPLES];
+			#if IMXRT_CACHE_ENABLED >=1
+			arm_dcache_delete((void*)src, AUDIO_BLOCK_SAMPLES * sizeof(slot_t));
+			#endif
+			if (metering) tdm_meter_slots(src, AUDIO_BLOCK_SAMPLES, F::meter_shift, &meter_acc[slot_channel(i)]);
+			if (block) F::from_slots(src, block, gains.group(slot_channel(i), 1, F::gain_steps));
+		}
+		if (metering) meter_period(AUDIO_BLOCK_SAMPLES);
+		transmit_blocks(new_block, new_mask);
+	} else if (F::frames < AUDIO_BLOCK_SAMPLES) {
+		// The ISR swaps blocks at the end of each audio block, so update() only
+		// supplies the next set and transmits the completed one.
+		bool need, ready;
+
+		need = !next_valid;
+		if (need) {
+			new_mask = slot_mask();
+			allocate_blocks(new_block, new_mask);
+		}
+		__disable_irq();
+		if (need) {
+			memcpy(block_next, new_block, sizeof(block_next));
+			next_mask = new_mask;
+			next_valid = true;
+		}
+		ready = ready_valid;
+		if (ready) {
+			memcpy(out_block, block_ready, sizeof(out_block));
+			out_mask = ready_mask;
+			ready_valid = false;
+		}
+		__enable_irq();
+		if (ready) transmit_blocks(out_block, out_mask);
+	} else {
+		new_mask = slot_mask();
+		allocate_blocks(new_block, new_mask);
+		__disable_irq();
+		memcpy(out_block, block_incoming, sizeof(out_block));
+		memcpy(block_incoming, new_block, sizeof(block_incoming));
+		__enable_irq();
+		// the blocks going out were allocated for last update's mask
+		out_mask = incoming_mask;
+		incoming_mask = new_mask;
+		transmit_blocks(out_block, out_mask);
+	}
+}
+
+#undef TDM_IN
+
+/********************************* output *********************************/
+
+#define TDM_OUT	AudioOutputTDM_Engine<F, SAI>
+
+template <class F, int SAI> typename F::block_t * TDM_OUT::block_input[TDM_OUT::channels];
+template <class F, int SAI> bool TDM_OUT::update_responsibility = false;
+template <class F, int SAI> DMAChannel TDM_OUT::dma(false);
+template <class F, int SAI> tdm_callback_t TDM_OUT::callback = nullptr;
+template <class F, int SAI> typename F::block_t * TDM_OUT::block_next[TDM_OUT::channels];
+template <class F, int SAI> volatile bool TDM_OUT::next_valid = false;
+template <class F, int SAI> uint32_t TDM_OUT::tx_offset = AUDIO_BLOCK_SAMPLES;
+template <class F, int SAI> uint32_t TDM_OUT::sub_count;
+template <class F, int SAI> DMAMEM __attribute__((aligned(32)))
+uint32_t TDM_OUT::tx_buffer[F::frames*2*TDM_OUT::stride];
+template <class F, int SAI> uint32_t TDM_OUT::tx_silent[2];
+template <class F, int SAI> tdm_monitor<TDM_OUT::channels> TDM_OUT::monitor;
+template <class F, int SAI> typename F::mask_t TDM_OUT::fed = 0;
+template <class F, int SAI> const uint32_t TDM_OUT::zeros[AUDIO_BLOCK_SAMPLES/2] = {0};
+template <class F, int SAI> int8_t TDM_OUT::tx_map[TDM_OUT::channels];	// set by begin_engine()
+template <class F, int SAI> int8_t TDM_OUT::tx_map_next[TDM_OUT::channels];
+template <class F, int SAI> volatile bool TDM_OUT::map_pending = false;
+template <class F, int SAI> tdm_gain_set<TDM_OUT::channels> TDM_OUT::gains;
+
+template <class F, int SAI>
+void TDM_OUT::begin_engine(bool bclk_rising)
+{
+	tdm_cycles_start(); // for the ISR stats
+	dma.begin(true); // Allocate the DMA channel first
+
+	for (int i=0; i < channels; i++) {
+		block_input[i] = nullptr;
+	}
+	memset(tx_buffer, 0, sizeof(tx_buffer));
+	tx_silent[0] = tx_silent[1] = 0xFFFFFFFF;
+	tdm_map_fill(tx_map, channels, nullptr, 0);
+
+	// TODO: should we set & clear the I2S_TCSR_SR bit here?
+	tdm_config<SAI>(F::frame_words, lines, AudioInputTDM_Engine<F, SAI>::lines, bclk_rising);
+	tdm_dma_tx<SAI>(dma, tx_buffer, sizeof(tx_buffer), lines);
+
+	update_responsibility = this->update_setup();
+	dma.enable();
+
+	tdm_start_tx<SAI>();
+	dma.attachInterrupt(isr);
+}
+
+// The ISR picks the new map up when it starts on an audio block
+template <class F, int SAI>
+void TDM_OUT::setChannelMap(const int8_t *map, int count)
+{
+	int8_t next[channels];
+
+	tdm_map_fill(next, channels, map, count);
+	__disable_irq();
+	memcpy(tx_map_next, next, sizeof(tx_map_next));
+	map_pending = true;
+	__enable_irq();
+}
+
+template <class F, int SAI>
+void TDM_OUT::isr(void)
+{
+	uint32_t *dest, *frame;
+	const uint32_t *src[F::group];
+	uint32_t i, g, saddr, half, bit, start, offset = 0;
+	bool written = false, finished = true, present;
+	block_t *block;
+	TDM_PROFILE_SCOPE("TDM out isr", SAI);
+
+	start = ARM_DWT_CYCCNT;
+	saddr = (uint32_t)(dma.TCD->SADDR);
+	dma.clearInterrupt();
+	if (saddr < (uint32_t)tx_buffer + sizeof(tx_buffer) / 2) {
+		// DMA is transmitting the first half of the buffer
+		// so we must fill the second half
+		dest = tx_buffer + F::frames*stride;
+		half = 1;
+	} else {
+		// DMA is transmitting the second half of the buffer
+		// so we must fill the first half
+		dest = tx_buffer;
+		half = 0;
+	}
+	frame = dest;
+	if (F::frames < AUDIO_BLOCK_SAMPLES) {
+		// run the audio graph once per audio block
+		if (update_responsibility && ++sub_count >= AUDIO_BLOCK_SAMPLES / F::frames) {
+			sub_count = 0;
+			F::update_all();
+		}
+		// start on new blocks at the first sub-block after update() delivers them
+		if (tx_offset >= AUDIO_BLOCK_SAMPLES && next_valid) {
+			memcpy(block_input, block_next, sizeof(block_input));
+			next_valid = false;
+			tx_offset = 0;
+		}
+		offset = tx_offset;
+		if (offset < AUDIO_BLOCK_SAMPLES) tx_offset += F::frames;
+	} else {
+		if (update_responsibility) F::update_all();
+	}
+	if (map_pending && (offset == 0 || offset >= AUDIO_BLOCK_SAMPLES)) {
+		memcpy(tx_map, tx_map_next, sizeof(tx_map));
+		map_pending = false;
+	}
+
+	for (i=0; i < channels; i += F::group) {
+		bit = 1 << (i / F::group);
+		// group's word, then data line
+		dest = frame + ((i % F::slots) * F::frame_words / F::slots) * lines + (i / F::slots);
+		present = false;
+		for (g = 0; g < F::group; g++) {
+			block = (tx_map[i+g] >= 0) ? block_input[tx_map[i+g]] : nullptr;
+			src[g] = block ? (const uint32_t *)(block->data) + offset/2 : zeros;
+			if (block) present = true;
+		}
+		if (present) {
+			F::template pack<stride>(dest, src, F::frames, gains.group(i, F::group, F::gain_steps));
+			tx_silent[half] &= ~bit;
+			written = true;
+		} else if (!(tx_silent[half] & bit)) {
+			// silent group: zero it once, then leave it alone while it stays silent
+			memset_tdm_tx<stride>(dest, F::frames);
+			tx_silent[half] |= bit;
+			written = true;
+		}
+	}
+
+	if (callback) {
+		callback((const uint32_t *)tdm_rx_latest<SAI>::buffer, frame, F::frames);
+		tx_silent[half] = 0; // the callback may write any slot
+		written = true;
+	}
+
+	#if IMXRT_CACHE_ENABLED >= 2
+	if (written)
+		arm_dcache_flush_delete(frame, sizeof(tx_buffer) / 2 );
+	#endif
+
+	if (F::frames < AUDIO_BLOCK_SAMPLES)
+		finished = (tx_offset >= AUDIO_BLOCK_SAMPLES);
+	for (i=0; finished && i < channels; i++) {
+		if (block_input[i]) {
+			F::release(block_input[i]);
+			block_input[i] = nullptr;
+		}
+	}
+	// the half just filled must not have been reached by the DMA yet
+	saddr = (uint32_t)(dma.TCD->SADDR);
+	monitor.isr_done(start, half, saddr < (uint32_t)tx_buffer + sizeof(tx_buffer) / 2 ? 0 : 1);
+}
+
+template <class F, int SAI>
+void TDM_OUT::update(void)
+{
+	block_t *prev[channels];
+	block_t *in[channels];
+	mask_t now = 0;
+	unsigned int i;
+	TDM_PROFILE_SCOPE("TDM out update", SAI);
+
+	for (i=0; i < channels; i++) {
+		in[i] = this->receiveReadOnly(i);
+		if (in[i]) now |= (mask_t)1 << i;
+		else if (fed & ((mask_t)1 << i)) monitor.null_blocks[i]++;
+	}
+	fed = now;
+	__disable_irq();
+	if (F::frames < AUDIO_BLOCK_SAMPLES) {
+		// New blocks wait in block_next until the ISR has finished sending the current ones
+		if (next_valid) {
+			memcpy(prev, block_next, sizeof(prev)); // not yet taken: replace them
+		} else {
+			memset(prev, 0, sizeof(prev));
+		}
+		memcpy(block_next, in, sizeof(block_next));
+		next_valid = true;
+	} else {
+		memcpy(prev, block_input, sizeof(prev));
+		memcpy(block_input, in, sizeof(block_input));
+	}
+	__enable_irq();
+	for (i=0; i < channels; i++) {
+		if (prev[i])
+			F::release(prev[i]);
+	}
+}
+
+#undef TDM_OUT
+
+#endif
@@ -0,0 +1,118 @@
+/* Fused per-slot gain and polarity for the TDM drivers
+ * The pack/unpack kernels multiply by a Q16.16 gain while the samples are in registers.
+ * A new gain is reached by a linear ramp over one audio block, so changes make no zipper noise.
+ * Kernels take the unity path, with no multiply at all, when a slot is at unity and not ramping.
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef _tdm_gain_h_
+#define _tdm_gain_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>      // AUDIO_BLOCK_SAMPLES
+#include "utility/dspinst.h" // signed_multiply_32x16b/t(), signed_saturate_rshift()
+
+#define TDM_GAIN_UNITY		65536	// Q16.16
+#define TDM_GAIN_MAX		256.0f	// +48 dB
+
+// Gain state of one slot, owned by the code that runs its kernel (ISR or update()).
+// The target is kept apart (setSlotGain() writes it) and picked up by tdm_gain_begin().
+struct tdm_gain {
+	int32_t now = TDM_GAIN_UNITY;	// Q16.16, negative inverts polarity
+	int32_t ramp_to = TDM_GAIN_UNITY;
+	int32_t step = 0;		// change per kernel step while ramping
+	int32_t ramp = 0;		// steps left
+};
+
+// Linear gain to Q16.16, limited to +/- TDM_GAIN_MAX
+static inline int32_t tdm_gain_q16(float gain)
+{
+	if (gain > TDM_GAIN_MAX) gain = TDM_GAIN_MAX;
+	if (gain < -TDM_GAIN_MAX) gain = -TDM_GAIN_MAX;
+	return (int32_t)(gain * TDM_GAIN_UNITY);
+}
+
+// Before a kernel: start a ramp to a new target over one audio block of steps
+// (AUDIO_BLOCK_SAMPLES / 2 for kernels that step once per sample pair).
+// Returns false if the slot can take the unity path.
+static inline bool tdm_gain_begin(tdm_gain &g, int32_t target, int steps)
+{
+	if (target != g.ramp_to) {
+		g.ramp_to = target;
+		g.ramp = steps;
+		g.step = (target - g.now) / steps;
+	}
+	return g.ramp || g.now != TDM_GAIN_UNITY;
+}
+
+// Gain for the next step of a kernel
+static inline int32_t tdm_gain_next(tdm_gain &g)
+{
+	if (g.ramp) {
+		g.now = (--g.ramp) ? g.now + g.step : g.ramp_to;
+	}
+	return g.now;
+}
+
+// Two int16 samples in one word times a Q16.16 gain, saturated
+static inline uint32_t tdm_gain_x2(uint32_t x, int32_t gain)
+{
+	int32_t lo = signed_multiply_32x16b(gain, x);
+	int32_t hi = signed_multiply_32x16t(gain, x);
+	lo = signed_saturate_rshift(lo, 16, 0);
+	hi = signed_saturate_rshift(hi, 16, 0);
+	return pack_16b_16b(hi, lo);
+}
+
+// One 32-bit sample times a Q16.16 gain, saturated
+static inline int32_t tdm_gain_32(int32_t x, int32_t gain)
+{
+	int64_t y = ((int64_t)x * gain) >> 16;
+	if (y > INT32_MAX) return INT32_MAX;
+	if (y < INT32_MIN) return INT32_MIN;
+	return y;
+}
+
+// n int16 samples (n even) times a ramping gain: DMA deinterleave slot buffers
+static inline void tdm_gain_copy16(int16_t *dest, const int16_t *src, int n, tdm_gain &g)
+{
+	uint32_t *d = (uint32_t *)dest;
+	const uint32_t *s = (const uint32_t *)src;
+
+	for (int j = 0; j < n/2; j++)
+		d[j] = tdm_gain_x2(s[j], tdm_gain_next(g));
+}
+
+// Gains of N slots: targets written by setSlotGain(), ramps run by the kernels
+template <int N> struct tdm_gain_set {
+	tdm_gain state[N];
+	volatile int32_t target[N];
+	volatile bool used = false;	// no slot has been set: skip the checks
+
+	tdm_gain_set() {
+		for (int i = 0; i < N; i++)
+			target[i] = TDM_GAIN_UNITY;
+	}
+	void set(int slot, float gain) {
+		if (slot < 0 || slot >= N) return;
+		target[slot] = tdm_gain_q16(gain);
+		used = true;
+	}
+	float get(int slot) {
+		if (slot < 0 || slot >= N) return 0.0f;
+		return (float)target[slot] / TDM_GAIN_UNITY;
+	}
+	// Gain state for the n slots from slot, for a kernel of steps per audio block;
+	// nullptr while all n are at unity.
+	tdm_gain *group(int slot, int n, int steps) {
+		bool on = false;
+		if (!used) return nullptr;
+		for (int i = slot; i < slot + n; i++)
+			on |= tdm_gain_begin(state[i], target[i], steps);
+		return on ? &state[slot] : nullptr;
+	}
+};
+
+#endif
@@ -0,0 +1,131 @@
+/* Fused peak/RMS metering for the TDM input drivers
+ * The deinterleave kernels gather each channel's extremes and power over a DMA period
+ * while the samples are in registers; at the end of the period the engine turns them
+ * into peak and power levels with the ballistics set by setMeterBallistics().
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef _tdm_meter_h_
+#define _tdm_meter_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>      // AUDIO_BLOCK_SAMPLES
+#include "utility/dspinst.h" // multiply_16tx16t_add_16bx16b(): SMUAD
+
+#define TDM_METER_CLIP		(32767.0f / 32768.0f)	// a period peaking at or above this counts as a clip
+#define TDM_METER_RELEASE	500		// default peak release time constant, mS
+#define TDM_METER_RMS		300		// default RMS integration time constant, mS
+
+// One channel over the current DMA period. Samples are int16, or 32-bit words >> 8 for TDM_32.
+struct tdm_meter_acc {
+	int32_t max = INT32_MIN, min = INT32_MAX;
+	uint64_t power = 0;	// sum of squares
+};
+
+// Metered level of one channel, full scale 1.0: see getMeters()
+typedef struct {
+	float peak;		// with instant attack and exponential release
+	float power;	// mean square, RMS = sqrtf(power)
+	uint32_t clips;	// DMA periods that reached TDM_METER_CLIP
+} tdm_meter_t;
+
+// Kernels that skip a channel's block still meter it: they write here instead
+template <int N> struct tdm_meter_scratch { static int16_t data[N]; };
+template <int N> int16_t tdm_meter_scratch<N>::data[N];
+
+// Per halfword maximum and minimum of two int16 pairs: SSUB16 sets the GE flags that SEL picks with
+static inline uint32_t tdm_max16x2(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_ARCH_7EM__)
+	uint32_t r;
+	asm ("ssub16 %0, %1, %2\n\tsel %0, %1, %2" : "=&r" (r) : "r" (a), "r" (b) : "cc");
+	return r;
+#else
+	int32_t hi = max((int32_t)a >> 16, (int32_t)b >> 16);
+	int32_t lo = max((int32_t)(int16_t)a, (int32_t)(int16_t)b);
+	return ((uint32_t)hi << 16) | (lo & 0xFFFF);
+#endif
+}
+
+static inline uint32_t tdm_min16x2(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_ARCH_7EM__)
+	uint32_t r;
+	asm ("ssub16 %0, %1, %2\n\tsel %0, %2, %1" : "=&r" (r) : "r" (a), "r" (b) : "cc");
+	return r;
+#else
+	int32_t hi = min((int32_t)a >> 16, (int32_t)b >> 16);
+	int32_t lo = min((int32_t)(int16_t)a, (int32_t)(int16_t)b);
+	return ((uint32_t)hi << 16) | (lo & 0xFFFF);
+#endif
+}
+
+// Two int16 samples in one word: about 2 cycles per sample
+static inline void tdm_meter_x2(uint32_t x, uint32_t &mx, uint32_t &mn, uint64_t &power)
+{
+	mx = tdm_max16x2(x, mx);
+	mn = tdm_min16x2(x, mn);
+	power += (uint32_t)multiply_16tx16t_add_16bx16b(x, x); // unsigned: two full scale squares make 2^31
+}
+
+// One sample
+static inline void tdm_meter_1(int32_t v, int32_t &mx, int32_t &mn, uint64_t &power)
+{
+	if (v > mx) mx = v;
+	if (v < mn) mn = v;
+	power += (int64_t)v * v;
+}
+
+// Fold packed extremes (start: 0x80008000 and 0x7FFF7FFF) and power into an accumulator
+static inline void tdm_meter_fold(tdm_meter_acc *m, uint32_t mx, uint32_t mn, uint64_t power)
+{
+	int32_t a = max((int32_t)mx >> 16, (int32_t)(int16_t)mx);
+	int32_t b = min((int32_t)mn >> 16, (int32_t)(int16_t)mn);
+
+	if (a > m->max) m->max = a;
+	if (b < m->min) m->min = b;
+	m->power += power;
+}
+
+// Meter n samples of a DMA deinterleave slot buffer
+static inline void tdm_meter_slots(const int16_t *src, int n, int shift, tdm_meter_acc *m)
+{
+	const uint32_t *p = (const uint32_t *)src;
+	uint32_t mx = 0x80008000, mn = 0x7FFF7FFF;
+	uint64_t power = 0;
+
+	for (int j = 0; j < n/2; j++)
+		tdm_meter_x2(p[j], mx, mn, power);
+	tdm_meter_fold(m, mx, mn, power);
+}
+
+static inline void tdm_meter_slots(const int32_t *src, int n, int shift, tdm_meter_acc *m)
+{
+	int32_t mx = m->max, mn = m->min;
+	uint64_t power = 0;
+
+	for (int j = 0; j < n; j++)
+		tdm_meter_1(src[j] >> shift, mx, mn, power);
+	m->max = mx;
+	m->min = mn;
+	m->power += power;
+}
+
+// End of a period of frames samples: apply the ballistics and start again.
+// full: full scale of the metered samples, decay and coef from setMeterBallistics().
+static inline void tdm_meter_finish(tdm_meter_acc &a, tdm_meter_t &m, int frames, float full, float decay, float coef)
+{
+	float peak = (float)max(a.max, -a.min) / full;
+	float power = (float)a.power / (frames * full * full);
+
+	if (peak >= TDM_METER_CLIP) m.clips++;
+	m.peak = (peak > m.peak * decay) ? peak : m.peak * decay;
+	m.power += (power - m.power) * coef;
+	a.max = INT32_MIN;
+	a.min = INT32_MAX;
+	a.power = 0;
+}
+
+#endif
@@ -0,0 +1,136 @@
+/* Cycle-count profiler for the TDM drivers and the CODEC control calls
+ * Named probes time a scope with the DWT cycle counter and keep a log2 histogram
+ * in a fixed static record, so the TDM ISRs can be seen apart from AudioProcessorUsage().
+ * tdm_profile_dump() prints every probe that has run.
+ *
+ * Off by default: with TDM_PROFILE undefined the probes compile to nothing.
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef _tdm_profile_h_
+#define _tdm_profile_h_
+
+#include <Arduino.h>
+#include "tdm_stats.h"
+
+//#define TDM_PROFILE				// uncomment to build the probes in
+#define TDM_PROFILE_BINS	24	// bin n counts times of 2^n to 2^(n+1)-1 cycles; the last bin takes anything longer
+
+#if defined(TDM_PROFILE)
+
+#if defined(__IMXRT1062__)
+#define TDM_PROFILE_CLOCK	F_CPU_ACTUAL
+#elif defined(KINETISK)
+#define TDM_PROFILE_CLOCK	F_CPU
+#else
+#error "TDM_PROFILE needs the DWT cycle counter: Teensy 3.x or 4.x"
+#endif
+
+// One probe: a static record at the place it times, listed on its first run
+struct tdm_probe {
+	const char *name;
+	int8_t unit;		// SAI for the drivers, -1 for none
+	bool listed;
+	tdm_probe *next;
+	uint32_t count, cycles_last, cycles_min, cycles_max;
+	uint64_t cycles_total;
+	uint32_t bins[TDM_PROFILE_BINS];
+
+	constexpr tdm_probe(const char *probeName, int probeUnit = -1) : name(probeName), unit(probeUnit), listed(false),
+		next(nullptr), count(0), cycles_last(0), cycles_min(0), cycles_max(0), cycles_total(0), bins{} {}
+
+	void record(uint32_t cycles);
+};
+
+template <int N> struct tdm_profile_list { static tdm_probe *head; };
+template <int N> tdm_probe *tdm_profile_list<N>::head = nullptr;
+
+// Each probe is only recorded from one context (an ISR, update() or loop())
+inline void tdm_probe::record(uint32_t cycles)
+{
+	int bin = 31 - __builtin_clz(cycles | 1);
+
+	if (!listed) {
+		uint32_t primask;
+		__asm__ volatile("mrs %0, primask" : "=r" (primask));	// the caller may have interrupts off
+		__disable_irq();
+		next = tdm_profile_list<0>::head;
+		tdm_profile_list<0>::head = this;
+		listed = true;
+		if (!primask) __enable_irq();
+	}
+	if (count++ == 0 || cycles < cycles_min)
+		cycles_min = cycles;
+	if (cycles > cycles_max)
+		cycles_max = cycles;
+	cycles_last = cycles;
+	cycles_total += cycles;
+	bins[bin < TDM_PROFILE_BINS ? bin : TDM_PROFILE_BINS - 1]++;
+}
+
+// Times from construction to the end of the enclosing scope
+class tdm_probe_scope {
+public:
+	tdm_probe_scope(tdm_probe &p) : probe(p) {
+		if (!p.listed) tdm_cycles_start();
+		start = ARM_DWT_CYCCNT;
+	}
+	~tdm_probe_scope() { probe.record(ARM_DWT_CYCCNT - start); }
+private:
+	tdm_probe &probe;
+	uint32_t start;
+};
+
+// Name the probe at the top of the scope to time. The record is a function static,
+// so a template gets one per instance: give the SAI as unit to tell them apart.
+#define TDM_PROFILE_SCOPE(name, unit) \
+	static tdm_probe _tdm_probe(name, unit); \
+	tdm_probe_scope _tdm_probe_scope(_tdm_probe)
+
+// Counts since the last reset, min/mean/max in uS, then the histogram bins that were hit
+inline void tdm_profile_dump(Print &out = Serial)
+{
+	tdm_probe p("");
+	float us = 1e6f / TDM_PROFILE_CLOCK;
+
+	out.println("probe                 unit      count   min uS  mean uS   max uS  last uS");
+	for (tdm_probe *q = tdm_profile_list<0>::head; q; q = q->next) {
+		__disable_irq();
+		p = *q;
+		__enable_irq();
+		out.printf("%-20s %5i %10lu %8.2f %8.2f %8.2f %8.2f\n", p.name, p.unit, p.count, p.cycles_min * us,
+			p.count ? (float)p.cycles_total / p.count * us : 0.0f, p.cycles_max * us, p.cycles_last * us);
+		out.print("  cycles");
+		for (int i = 0; i < TDM_PROFILE_BINS; i++) {
+			if (p.bins[i])
+				out.printf(" %s%lu:%lu", (i == TDM_PROFILE_BINS - 1) ? ">=" : "", 1UL << i, p.bins[i]);
+		}
+		out.println();
+	}
+}
+
+// Clear the counts; probes stay listed
+inline void tdm_profile_reset(void)
+{
+	for (tdm_probe *q = tdm_profile_list<0>::head; q; q = q->next) {
+		__disable_irq();
+		q->count = q->cycles_last = q->cycles_min = q->cycles_max = 0;
+		q->cycles_total = 0;
+		for (int i = 0; i < TDM_PROFILE_BINS; i++)
+			q->bins[i] = 0;
+		__enable_irq();
+	}
+}
+
+#else
+
+#define TDM_PROFILE_SCOPE(name, unit)
+
+inline void tdm_profile_dump(Print &out = Serial) { out.println("TDM_PROFILE is not defined in tdm_profile.h"); }
+inline void tdm_profile_reset(void) {}
+
+#endif
+
+#endif
@@ -0,0 +1,404 @@
+/* SAI hardware layer for the TDM drivers
+ * Register layout, clock root, pins and DMA requests of SAI1 and SAI2 (Teensy 4),
+ * and the frame and DMA set-up shared by every TDM format.
+ * Teensy 3 (KINETISK) has one SAI, I2S0, which is instance 1 here.
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef _tdm_sai_h_
+#define _tdm_sai_h_
+
+#include <Arduino.h>
+#include <DMAChannel.h>
+#include "utility/imxrt_hw.h"	// set_audioClock()
+
+// Latest received half buffer for each SAI, for the low-latency callbacks
+template <int SAI> struct tdm_rx_latest { static const void * volatile buffer; };
+template <int SAI> const void * volatile tdm_rx_latest<SAI>::buffer = nullptr;
+
+// Frame rate of the TDM clocks: AUDIO_SAMPLE_RATE_EXACT until tdm_set_sample_rate() changes it
+inline int &tdm_fs(void) { static int fs = AUDIO_SAMPLE_RATE_EXACT; return fs; }
+
+#if defined(__IMXRT1062__)
+
+// SAI register block (i.MX RT1060 reference manual, SAI chapter)
+typedef struct {
+	volatile uint32_t VERID, PARAM;
+	volatile uint32_t TCSR, TCR1, TCR2, TCR3, TCR4, TCR5;
+	volatile uint32_t TDR[8];
+	volatile uint32_t TFR[8];
+	volatile uint32_t TMR;
+	volatile uint32_t unused1[9];
+	volatile uint32_t RCSR, RCR1, RCR2, RCR3, RCR4, RCR5;
+	volatile uint32_t RDR[8];
+	volatile uint32_t RFR[8];
+	volatile uint32_t RMR;
+} tdm_sai_regs_t;
+
+// Both instances take their clock root from the audio PLL (PLL4) with the same dividers:
+// the frame clocks come from one source and cannot drift apart.
+// set_audioClock() leaves the PLL alone if another driver has already started it, unless forced.
+static inline void tdm_sai_pll(int &n1, int &n2, bool force = false)
+{
+	int fs = tdm_fs();
+	// PLL between 27*24 = 648MHz und 54*24=1296MHz
+	n1 = 4; //SAI prescaler 4 => (n1*n2) = multiple of 4
+	n2 = 1 + (24000000 * 27) / (fs * 256 * n1);
+
+	double C = ((double)fs * 256 * n1 * n2) / 24000000;
+	int c0 = C;
+	int c2 = 10000;
+	int c1 = C * c2 - (c0 * c2);
+	set_audioClock(c0, c1, c2, force);
+	n1 = n1 / 2; //Double Speed for TDM
+}
+
+template <int SAI> struct tdm_sai;
+
+// SAI1: the receiver is the clock master (pins 21, 20), the transmitter is synchronous to it.
+// Four data lines each way, on shared pins: see TDM_A_TX_LINES.
+template <> struct tdm_sai<1> {
+	static tdm_sai_regs_t &regs(void) { return *(tdm_sai_regs_t *)IMXRT_SAI1_ADDRESS; }
+	static const uint8_t dmamux_tx = DMAMUX_SOURCE_SAI1_TX;
+	static const uint8_t dmamux_rx = DMAMUX_SOURCE_SAI1_RX;
+	static const bool rx_master = true;
+	static const int max_lines = 4;
+
+	static void clock_gate(void) { CCM_CCGR5 |= CCM_CCGR5_SAI1(CCM_CCGR_ON); }
+	static void clock_root(int n1, int n2) {
+		CCM_CSCMR1 = (CCM_CSCMR1 & ~(CCM_CSCMR1_SAI1_CLK_SEL_MASK))
+			   | CCM_CSCMR1_SAI1_CLK_SEL(2); // &0x03 // (0,1,2): PLL3PFD0, PLL5, PLL4
+		CCM_CS1CDR = (CCM_CS1CDR & ~(CCM_CS1CDR_SAI1_CLK_PRED_MASK | CCM_CS1CDR_SAI1_CLK_PODF_MASK))
+			   | CCM_CS1CDR_SAI1_CLK_PRED(n1-1) // &0x07
+			   | CCM_CS1CDR_SAI1_CLK_PODF(n2-1); // &0x3f
+		IOMUXC_GPR_GPR1 = (IOMUXC_GPR_GPR1 & ~(IOMUXC_GPR_GPR1_SAI1_MCLK1_SEL_MASK))
+				| (IOMUXC_GPR_GPR1_SAI1_MCLK_DIR | IOMUXC_GPR_GPR1_SAI1_MCLK1_SEL(0));	//Select MCLK
+	}
+	static void clock_pins(void) {
+		CORE_PIN23_CONFIG = 3;  //1:MCLK
+		CORE_PIN21_CONFIG = 3;  //1:RX_BCLK
+		CORE_PIN20_CONFIG = 3;  //1:RX_SYNC
+	}
+	static void tx_pins(int lines) {
+		CORE_PIN7_CONFIG  = 3;  //1:TX_DATA0
+		if (lines >= 2) CORE_PIN32_CONFIG = 3;  //1:TX_DATA1
+		if (lines >= 3) CORE_PIN9_CONFIG  = 3;  //1:TX_DATA2
+		if (lines >= 4) CORE_PIN6_CONFIG  = 3;  //1:TX_DATA3
+	}
+	static void rx_pins(int lines) {
+		CORE_PIN8_CONFIG  = 3;  //RX_DATA0
+		IOMUXC_SAI1_RX_DATA0_SELECT_INPUT = 2;
+		if (lines >= 2) {
+			CORE_PIN6_CONFIG  = 3;  //RX_DATA1
+			IOMUXC_SAI1_RX_DATA1_SELECT_INPUT = 1;
+		}
+		if (lines >= 3) {
+			CORE_PIN9_CONFIG  = 3;  //RX_DATA2
+			IOMUXC_SAI1_RX_DATA2_SELECT_INPUT = 1;
+		}
+		if (lines >= 4) {
+			CORE_PIN32_CONFIG = 3;  //RX_DATA3
+			IOMUXC_SAI1_RX_DATA3_SELECT_INPUT = 1;
+		}
+	}
+};
+
+// SAI2: the transmitter is the clock master (pins 4, 3), the receiver is synchronous to it.
+// One data line each way: TX_DATA0 on pin 2, RX_DATA0 on pin 5. MCLK on pin 33.
+template <> struct tdm_sai<2> {
+	static tdm_sai_regs_t &regs(void) { return *(tdm_sai_regs_t *)IMXRT_SAI2_ADDRESS; }
+	static const uint8_t dmamux_tx = DMAMUX_SOURCE_SAI2_TX;
+	static const uint8_t dmamux_rx = DMAMUX_SOURCE_SAI2_RX;
+	static const bool rx_master = false;
+	static const int max_lines = 1;
+
+	static void clock_gate(void) { CCM_CCGR5 |= CCM_CCGR5_SAI2(CCM_CCGR_ON); }
+	static void clock_root(int n1, int n2) {
+		CCM_CSCMR1 = (CCM_CSCMR1 & ~(CCM_CSCMR1_SAI2_CLK_SEL_MASK))
+			   | CCM_CSCMR1_SAI2_CLK_SEL(2); // &0x03 // (0,1,2): PLL3PFD0, PLL5, PLL4
+		CCM_CS2CDR = (CCM_CS2CDR & ~(CCM_CS2CDR_SAI2_CLK_PRED_MASK | CCM_CS2CDR_SAI2_CLK_PODF_MASK))
+			   | CCM_CS2CDR_SAI2_CLK_PRED(n1-1) // &0x07
+			   | CCM_CS2CDR_SAI2_CLK_PODF(n2-1); // &0x3f
+		IOMUXC_GPR_GPR1 = (IOMUXC_GPR_GPR1 & ~(IOMUXC_GPR_GPR1_SAI2_MCLK3_SEL_MASK))
+				| (IOMUXC_GPR_GPR1_SAI2_MCLK_DIR | IOMUXC_GPR_GPR1_SAI2_MCLK3_SEL(0));	//Select MCLK
+	}
+	static void clock_pins(void) {
+		CORE_PIN33_CONFIG = 2;  //2:MCLK
+		CORE_PIN4_CONFIG  = 2;  //2:TX_SYNC
+		CORE_PIN3_CONFIG  = 2;  //2:TX_BCLK
+	}
+	static void tx_pins(int lines) {
+		CORE_PIN2_CONFIG  = 2;  //2:TX_DATA0
+	}
+	static void rx_pins(int lines) {
+		CORE_PIN5_CONFIG  = 2;  //2:RX_DATA0
+		IOMUXC_SAI2_RX_DATA0_SELECT_INPUT = 0;
+	}
+};
+
+#endif // __IMXRT1062__
+
+// Move the running TDM clocks to a new frame rate: PLL4 and the clock root of every SAI that is gated on.
+// Frame layout and DMA are untouched, so the drivers keep running; the caller mutes the codecs around it.
+// Teensy 3 derives MCLK from the CPU clock through a fixed table for the nominal 44100
+// (AUDIO_SAMPLE_RATE_EXACT is the rate that table really gives): any other rate returns false there.
+inline bool tdm_set_sample_rate(int fs)
+{
+#if defined(__IMXRT1062__)
+	int n1, n2;
+
+	tdm_fs() = fs;
+	tdm_sai_pll(n1, n2, true);
+	if (CCM_CCGR5 & CCM_CCGR5_SAI1(CCM_CCGR_ON)) tdm_sai<1>::clock_root(n1, n2);
+	if (CCM_CCGR5 & CCM_CCGR5_SAI2(CCM_CCGR_ON)) tdm_sai<2>::clock_root(n1, n2);
+	return true;
+#else
+	return fs == 44100;
+#endif
+}
+
+#if defined(KINETISK)
+// MCLK needs to be 48e6 / 1088 * 512 = 22.588235 MHz -> 44.117647 kHz sample rate
+//
+#if F_CPU == 96000000 || F_CPU == 48000000 || F_CPU == 24000000
+  // PLL is at 96 MHz in these modes
+  #define MCLK_MULT 4
+  #define MCLK_DIV  17
+#elif F_CPU == 72000000
+  #define MCLK_MULT 16
+  #define MCLK_DIV  51
+#elif F_CPU == 120000000
+  #define MCLK_MULT 16
+  #define MCLK_DIV  85
+#elif F_CPU == 144000000
+  #define MCLK_MULT 8
+  #define MCLK_DIV  51
+#elif F_CPU == 168000000
+  #define MCLK_MULT 16
+  #define MCLK_DIV  119
+#elif F_CPU == 180000000
+  #define MCLK_MULT 32
+  #define MCLK_DIV  255
+  #define MCLK_SRC  0
+#elif F_CPU == 192000000
+  #define MCLK_MULT 2
+  #define MCLK_DIV  17
+#elif F_CPU == 216000000
+  #define MCLK_MULT 12
+  #define MCLK_DIV  17
+  #define MCLK_SRC  1
+#elif F_CPU == 240000000
+  #define MCLK_MULT 2
+  #define MCLK_DIV  85
+  #define MCLK_SRC  0
+#elif F_CPU == 256000000
+  #define MCLK_MULT 12
+  #define MCLK_DIV  17
+  #define MCLK_SRC  1
+#else
+  #error "This CPU Clock Speed is not supported by the Audio library";
+#endif
+
+#ifndef MCLK_SRC
+#if F_CPU >= 20000000
+  #define MCLK_SRC  3  // the PLL
+#else
+  #define MCLK_SRC  0  // system clock
+#endif
+#endif
+#endif // KINETISK
+
+// Frame: frame_words 32-bit words per data line (16 x 16-bit or 8 x 32-bit slots: 8, 16 x 32-bit slots: 16).
+// MCLK is 512 fs: BCLK is MCLK / 2 for 8 word frames, MCLK itself (divider bypassed) for 16 word frames.
+// bclk_rising: codecs sample data on the rising edge of BCLK.
+// The first driver to start configures the SAI; later ones find it running and share its frame.
+template <int SAI>
+void tdm_config(int frame_words, int tx_lines, int rx_lines, bool bclk_rising)
+{
+#if defined(KINETISK)
+	SIM_SCGC6 |= SIM_SCGC6_I2S;
+	SIM_SCGC7 |= SIM_SCGC7_DMA;
+	SIM_SCGC6 |= SIM_SCGC6_DMAMUX;
+
+	// if either transmitter or receiver is enabled, do nothing
+	if (I2S0_TCSR & I2S_TCSR_TE) return;
+	if (I2S0_RCSR & I2S_RCSR_RE) return;
+
+	uint32_t bclk_div = (frame_words > 8) ? I2S_TCR2_BYP : I2S_TCR2_DIV(0);
+
+	// enable MCLK output
+	I2S0_MCR = I2S_MCR_MICS(MCLK_SRC) | I2S_MCR_MOE;
+	while (I2S0_MCR & I2S_MCR_DUF) ;
+	I2S0_MDR = I2S_MDR_FRACT((MCLK_MULT-1)) | I2S_MDR_DIVIDE((MCLK_DIV-1));
+
+	// configure transmitter
+	I2S0_TMR = 0;
+	I2S0_TCR1 = I2S_TCR1_TFW(4);
+	I2S0_TCR2 = I2S_TCR2_SYNC(0) | (bclk_rising ? I2S_TCR2_BCP : 0) | I2S_TCR2_MSEL(1)
+		| I2S_TCR2_BCD | bclk_div;
+	I2S0_TCR3 = I2S_TCR3_TCE;
+	I2S0_TCR4 = I2S_TCR4_FRSZ(frame_words - 1) | I2S_TCR4_SYWD(0) | I2S_TCR4_MF
+		| I2S_TCR4_FSE | I2S_TCR4_FSD;
+	I2S0_TCR5 = I2S_TCR5_WNW(31) | I2S_TCR5_W0W(31) | I2S_TCR5_FBT(31);
+
+	// configure receiver (sync'd to transmitter clocks)
+	I2S0_RMR = 0;
+	I2S0_RCR1 = I2S_RCR1_RFW(4);
+	I2S0_RCR2 = I2S_RCR2_SYNC(1) | (bclk_rising ? I2S_TCR2_BCP : 0) | I2S_RCR2_MSEL(1)
+		| I2S_RCR2_BCD | bclk_div;
+	I2S0_RCR3 = I2S_RCR3_RCE;
+	I2S0_RCR4 = I2S_RCR4_FRSZ(frame_words - 1) | I2S_RCR4_SYWD(0) | I2S_RCR4_MF
+		| I2S_RCR4_FSE | I2S_RCR4_FSD;
+	I2S0_RCR5 = I2S_RCR5_WNW(31) | I2S_RCR5_W0W(31) | I2S_RCR5_FBT(31);
+
+	// configure pin mux for 3 clock signals
+	CORE_PIN23_CONFIG = PORT_PCR_MUX(6); // pin 23, PTC2, I2S0_TX_FS (LRCLK) - 44.1kHz
+	CORE_PIN9_CONFIG  = PORT_PCR_MUX(6); // pin  9, PTC3, I2S0_TX_BCLK  - 11.2 MHz
+	CORE_PIN11_CONFIG = PORT_PCR_MUX(6); // pin 11, PTC6, I2S0_MCLK - 22.5 MHz
+
+#elif defined(__IMXRT1062__)
+	typedef tdm_sai<SAI> S;
+	tdm_sai_regs_t &sai = S::regs();
+	int n1, n2;
+
+	S::clock_gate();
+
+	// if either transmitter or receiver is enabled, do nothing
+	if (sai.TCSR & I2S_TCSR_TE) return;
+	if (sai.RCSR & I2S_RCSR_RE) return;
+//PLL:
+	tdm_sai_pll(n1, n2);
+	S::clock_root(n1, n2);
+
+	// configure transmitter and receiver: one is the clock master, the other synchronous to it
+	int rsync = S::rx_master ? 0 : 1;
+	int tsync = S::rx_master ? 1 : 0;
+	uint32_t bcp = bclk_rising ? I2S_TCR2_BCP : 0;
+	uint32_t bclk_div = (frame_words > 8) ? I2S_TCR2_BYP : I2S_TCR2_DIV(0);
+
+	sai.TMR = 0;
+	sai.TCR1 = I2S_TCR1_RFW(4);
+	sai.TCR2 = I2S_TCR2_SYNC(tsync) | bcp | I2S_TCR2_MSEL(1)
+		| I2S_TCR2_BCD | bclk_div;
+	sai.TCR3 = I2S_TCR3_TCE * ((1 << tx_lines) - 1);	// TCE bit per data line
+	sai.TCR4 = I2S_TCR4_FRSZ(frame_words - 1) | I2S_TCR4_SYWD(0) | I2S_TCR4_MF
+		| I2S_TCR4_FSE | I2S_TCR4_FSD;
+	sai.TCR5 = I2S_TCR5_WNW(31) | I2S_TCR5_W0W(31) | I2S_TCR5_FBT(31);
+
+	sai.RMR = 0;
+	sai.RCR1 = I2S_RCR1_RFW(4);
+	sai.RCR2 = I2S_RCR2_SYNC(rsync) | bcp | I2S_RCR2_MSEL(1)
+		| I2S_RCR2_BCD | bclk_div;
+	sai.RCR3 = I2S_RCR3_RCE * ((1 << rx_lines) - 1);	// RCE bit per data line
+	sai.RCR4 = I2S_RCR4_FRSZ(frame_words - 1) | I2S_RCR4_SYWD(0) | I2S_RCR4_MF
+		| I2S_RCR4_FSE | I2S_RCR4_FSD;
+	sai.RCR5 = I2S_RCR5_WNW(31) | I2S_RCR5_W0W(31) | I2S_RCR5_FBT(31);
+
+	S::clock_pins();
+#endif
+}
+
+// Transmit DMA: a circular buffer of two halves, interrupting at each half.
+// With more than one data line the minor loop writes one word to each of TDR0..TDRn.
+template <int SAI>
+void tdm_dma_tx(DMAChannel &dma, void *buffer, uint32_t bytes, int lines)
+{
+	dma.TCD->SADDR = buffer;
+	dma.TCD->SOFF = 4;
+	dma.TCD->ATTR = DMA_TCD_ATTR_SSIZE(2) | DMA_TCD_ATTR_DSIZE(2);
+	dma.TCD->SLAST = -bytes;
+	dma.TCD->DLASTSGA = 0;
+	dma.TCD->CITER_ELINKNO = bytes / (4 * lines);
+	dma.TCD->BITER_ELINKNO = bytes / (4 * lines);
+	dma.TCD->CSR = DMA_TCD_CSR_INTHALF | DMA_TCD_CSR_INTMAJOR;
+#if defined(KINETISK)
+	CORE_PIN22_CONFIG = PORT_PCR_MUX(6); // pin 22, PTC1, I2S0_TXD0
+	dma.TCD->NBYTES_MLNO = 4;
+	dma.TCD->DADDR = &I2S0_TDR0;
+	dma.TCD->DOFF = 0;
+	dma.triggerAtHardwareEvent(DMAMUX_SOURCE_I2S0_TX);
+#elif defined(__IMXRT1062__)
+	tdm_sai<SAI>::tx_pins(lines);
+	if (lines > 1) {
+		// minor loop: one word to each of TDR0..TDRn, then back to TDR0
+		dma.TCD->NBYTES_MLOFFYES = DMA_TCD_NBYTES_DMLOE
+			| DMA_TCD_NBYTES_MLOFFYES_MLOFF(-4 * lines)
+			| DMA_TCD_NBYTES_MLOFFYES_NBYTES(4 * lines);
+		dma.TCD->DOFF = 4;
+	} else {
+		dma.TCD->NBYTES_MLNO = 4;
+		dma.TCD->DOFF = 0;
+	}
+	dma.TCD->DADDR = &tdm_sai<SAI>::regs().TDR[0];
+	dma.triggerAtHardwareEvent(tdm_sai<SAI>::dmamux_tx);
+#endif
+}
+
+// Receive DMA: the mirror of tdm_dma_tx()
+template <int SAI>
+void tdm_dma_rx(DMAChannel &dma, void *buffer, uint32_t bytes, int lines)
+{
+	dma.TCD->ATTR = DMA_TCD_ATTR_SSIZE(2) | DMA_TCD_ATTR_DSIZE(2);
+	dma.TCD->SLAST = 0;
+	dma.TCD->DADDR = buffer;
+	dma.TCD->DOFF = 4;
+	dma.TCD->CITER_ELINKNO = bytes / (4 * lines);
+	dma.TCD->DLASTSGA = -bytes;
+	dma.TCD->BITER_ELINKNO = bytes / (4 * lines);
+	dma.TCD->CSR = DMA_TCD_CSR_INTHALF | DMA_TCD_CSR_INTMAJOR;
+#if defined(KINETISK)
+	CORE_PIN13_CONFIG = PORT_PCR_MUX(4); // pin 13, PTC5, I2S0_RXD0
+	dma.TCD->SADDR = &I2S0_RDR0;
+	dma.TCD->SOFF = 0;
+	dma.TCD->NBYTES_MLNO = 4;
+	dma.triggerAtHardwareEvent(DMAMUX_SOURCE_I2S0_RX);
+#elif defined(__IMXRT1062__)
+	tdm_sai<SAI>::rx_pins(lines);
+	dma.TCD->SADDR = &tdm_sai<SAI>::regs().RDR[0];
+	if (lines > 1) {
+		// minor loop: one word from each of RDR0..RDRn, then back to RDR0
+		dma.TCD->SOFF = 4;
+		dma.TCD->NBYTES_MLOFFYES = DMA_TCD_NBYTES_SMLOE
+			| DMA_TCD_NBYTES_MLOFFYES_MLOFF(-4 * lines)
+			| DMA_TCD_NBYTES_MLOFFYES_NBYTES(4 * lines);
+	} else {
+		dma.TCD->SOFF = 0;
+		dma.TCD->NBYTES_MLNO = 4;
+	}
+	dma.triggerAtHardwareEvent(tdm_sai<SAI>::dmamux_rx);
+#endif
+}
+
+// Start the transmitter once its DMA is enabled
+template <int SAI>
+void tdm_start_tx(void)
+{
+#if defined(KINETISK)
+	I2S0_TCSR = I2S_TCSR_SR;
+	I2S0_TCSR = I2S_TCSR_TE | I2S_TCSR_BCE | I2S_TCSR_FRDE;
+#elif defined(__IMXRT1062__)
+	tdm_sai_regs_t &sai = tdm_sai<SAI>::regs();
+	if (tdm_sai<SAI>::rx_master)
+		sai.RCSR |= I2S_RCSR_RE | I2S_RCSR_BCE; // RX clock enable, because TX is sync'd to RX
+	sai.TCSR = I2S_TCSR_TE | I2S_TCSR_BCE | I2S_TCSR_FRDE;
+#endif
+}
+
+// Start the receiver once its DMA is enabled
+template <int SAI>
+void tdm_start_rx(void)
+{
+#if defined(KINETISK)
+	I2S0_RCSR |= I2S_RCSR_RE | I2S_RCSR_BCE | I2S_RCSR_FRDE | I2S_RCSR_FR;
+	I2S0_TCSR |= I2S_TCSR_TE | I2S_TCSR_BCE; // TX clock enable, because sync'd to TX
+#elif defined(__IMXRT1062__)
+	tdm_sai_regs_t &sai = tdm_sai<SAI>::regs();
+	sai.RCSR = I2S_RCSR_RE | I2S_RCSR_BCE | I2S_RCSR_FRDE | I2S_RCSR_FR;
+	if (!tdm_sai<SAI>::rx_master)
+		sai.TCSR |= I2S_TCSR_TE | I2S_TCSR_BCE; // TX clock enable, because RX is sync'd to TX
+#endif
+}
+
+#endif
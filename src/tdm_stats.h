@@ -0,0 +1,80 @@
+/* Health counters for the TDM drivers
+ * Each driver keeps one tdm_monitor, updated by its DMA ISR and update(),
+ * and hands out a tdm_stats snapshot that is cheap enough to take from loop().
+ *
+ * This software is published under the MIT Licence
+ * R. Palmer 2025
+ */
+
+#ifndef _tdm_stats_h_
+#define _tdm_stats_h_
+
+#include <Arduino.h>
+
+// The ISR times come from the DWT cycle counter. The Teensy 4 startup code runs it; Teensy 3 leaves it off.
+inline void tdm_cycles_start(void)
+{
+#if defined(KINETISK)
+	ARM_DEMCR |= ARM_DEMCR_TRCENA;
+	ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+}
+
+// Snapshot of a driver's counters since the last resetStats(). N = channels.
+template <int N> struct tdm_stats {
+	uint32_t isr_count;		// DMA interrupts serviced
+	uint32_t cycles_last;	// CPU cycles (DWT) used by the latest ISR
+	uint32_t cycles_min, cycles_max, cycles_mean;
+	uint32_t missed;		// DMA deadlines missed: a half buffer skipped, or the DMA back in the one being serviced
+	uint32_t alloc_fails;	// blocks that could not be allocated (input drivers)
+	uint32_t null_blocks[N];	// per channel: missing blocks sent as silence or a fallback (outputs: first of each gap)
+};
+
+template <int N> struct tdm_monitor {
+	volatile uint32_t isr_count, cycles_last, cycles_min, cycles_max, missed, alloc_fails;
+	volatile uint64_t cycles_total;
+	volatile uint32_t null_blocks[N];
+	int8_t last_part = -1;
+
+	// End of a DMA ISR started at DWT count start. part: the half buffer (or segment) it serviced,
+	// busy: the one the DMA is in now, parts: how many there are. Services must come in order,
+	// and must be over before the DMA comes round to the part being serviced.
+	void isr_done(uint32_t start, int part, int busy, int parts = 2) {
+		uint32_t cycles = ARM_DWT_CYCCNT - start;
+
+		if ((last_part >= 0 && part != (last_part + 1) % parts) || busy == part)
+			missed++;
+		last_part = part;
+		if (isr_count++ == 0 || cycles < cycles_min)
+			cycles_min = cycles;
+		if (cycles > cycles_max)
+			cycles_max = cycles;
+		cycles_last = cycles;
+		cycles_total += cycles;
+	}
+
+	void snapshot(tdm_stats<N> &s) {
+		__disable_irq();
+		s.isr_count = isr_count;
+		s.cycles_last = cycles_last;
+		s.cycles_min = cycles_min;
+		s.cycles_max = cycles_max;
+		s.cycles_mean = isr_count ? cycles_total / isr_count : 0;
+		s.missed = missed;
+		s.alloc_fails = alloc_fails;
+		for (int i = 0; i < N; i++)
+			s.null_blocks[i] = null_blocks[i];
+		__enable_irq();
+	}
+
+	void reset(void) {
+		__disable_irq();
+		isr_count = cycles_last = cycles_min = cycles_max = missed = alloc_fails = 0;
+		cycles_total = 0;
+		for (int i = 0; i < N; i++)
+			null_blocks[i] = 0;
+		__enable_irq();
+	}
+};
+
+#endif
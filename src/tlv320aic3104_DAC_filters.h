@@ -16,121 +16,119 @@ Note (PS):
 
 #define xscalex 32768.0 // 16-bits 
 
-void AudioControlTLV320AIC3104::setHighpass(int stage, float frequency, float q, int8_t channel, int8_t codec) 
+// Normal biquad coefficients, scaled to 16 bits: converted to the TI model in setDACfilter().
+// q is the slope for the shelves; gain (dB) is only used by them.
+void AudioControlTLV320AIC3104::designFilter(aicFilterType type, float frequency, float q, float gain, int *coef)
 {
-		int coef[5];
-		frequency = frequency / 2.0;
-		double w0 = frequency * (2.0f * 3.141592654f / AUDIO_SAMPLE_RATE_EXACT);
-		double sinW0 = sin(w0);
-		double alpha = sinW0 / ((double)q * 2.0);
-		double cosW0 = cos(w0);
-		double scalex = xscalex / (1.0 + alpha);
-		// normal biquad calcs. Converted in setDACfilter().
-		/* b0 */ coef[0] = ((1.0 + cosW0)/2 ) * scalex; 
-		/* b1 */ coef[1] = -(1.0 + cosW0) * scalex; 
-		/* b2 */ coef[2] = coef[0];
-		/* a1 */ coef[3] = (-2.0 * cosW0) * scalex; 
-		/* a2 */ coef[4] = (1.0 - alpha) * scalex; 
-		/*if(_verbose > 1)
+	frequency = frequency / 2.0;
+	double w0 = frequency * (2.0f * 3.141592654f / _sampleRate);
+	double sinW0 = sin(w0);
+	double cosW0 = cos(w0);
+	double alpha, scalex, a, sinsq, aMinus, aPlus;
+
+	switch(type)
+	{
+	case AIC_LOWSHELF:
+	case AIC_HIGHSHELF:
+		a = pow(10.0, gain/40.0f);
+		//double alpha = (sinW0 * sqrt((a+1/a)*(1/slope-1)+2) ) / 2.0;
+		//generate three helper-values (intermediate results):
+		sinsq = sinW0 * sqrt( (pow(a,2.0)+1.0)*(1.0/(double)q-1.0)+2.0*a );
+		aMinus = (a-1.0)*cosW0;
+		aPlus = (a+1.0)*cosW0;
+		if(type == AIC_LOWSHELF)
 		{
-			Serial.printf("+++Teensy Audio: Stage %i\n", stage);
-			for(int i = 0; i < 5; i++)
-				Serial.printf("%i: 0x%04X [%i]\n", i, coef[i], coef[i]); 	
+			scalex = xscalex / ( (a+1.0) + aMinus + sinsq);
+			/* b0 */ coef[0] =		a *	( (a+1.0) - aMinus + sinsq	) * scalex;
+			/* b1 */ coef[1] =  2.0*a * ( (a-1.0) - aPlus  			) * scalex;
+			/* b2 */ coef[2] =		a * ( (a+1.0) - aMinus - sinsq 	) * scalex;
+			/* a1 */ coef[3] = -2.0*	( (a-1.0) + aPlus			) * scalex;
+			/* a2 */ coef[4] =  			( (a+1.0) + aMinus - sinsq	) * scalex;
 		}
-		*/
-	setDACfilter(stage, coef, channel, codec);
-}
+		else
+		{
+			scalex = xscalex / ( (a+1.0) - aMinus + sinsq);
+			/* b0 */ coef[0] =		a *	( (a+1.0) + aMinus + sinsq	) * scalex;
+			/* b1 */ coef[1] = -2.0*a * ( (a-1.0) + aPlus  			) * scalex;
+			/* b2 */ coef[2] =		a * ( (a+1.0) + aMinus - sinsq 	) * scalex;
+			/* a1 */ coef[3] =  2.0*	( (a-1.0) - aPlus			) * scalex;
+			/* a2 */ coef[4] =  			( (a+1.0) - aMinus - sinsq	) * scalex;
+		}
+		return;
+	default:
+		break;
+	}
 
-void AudioControlTLV320AIC3104::setLowpass(int stage, float frequency, float q, int8_t channel, int8_t codec) 
-{
-		int coef[5];
-		frequency = frequency / 2.0;
-		double w0 = frequency * (2.0f * 3.141592654f / AUDIO_SAMPLE_RATE_EXACT);
-		double sinW0 = sin(w0);
-		double alpha = sinW0 / ((double)q * 2.0);
-		double cosW0 = cos(w0);
-		double scalex = xscalex / (1.0 + alpha);
+	alpha = sinW0 / ((double)q * 2.0);
+	scalex = xscalex / (1.0 + alpha);
+	/* a1 */ coef[3] = (-2.0 * cosW0) * scalex;
+	/* a2 */ coef[4] = (1.0 - alpha) * scalex;
+	switch(type)
+	{
+	case AIC_HIGHPASS:
+		/* b0 */ coef[0] = ((1.0 + cosW0)/2 ) * scalex; 
+		/* b1 */ coef[1] = -(1.0 + cosW0) * scalex; 
+		/* b2 */ coef[2] = coef[0];
+		break;
+	case AIC_LOWPASS:
 		/* b0 */ coef[0] = ((1.0 - cosW0) / 2.0) * scalex;
 		/* b1 */ coef[1] = (1.0 - cosW0) * scalex;
 		/* b2 */ coef[2] = coef[0];
-		/* a1 */ coef[3] = (-2.0 * cosW0) * scalex;
-		/* a2 */ coef[4] = (1.0 - alpha) * scalex;
-		setDACfilter(stage, coef, channel, codec);
-	}	
-	void AudioControlTLV320AIC3104::setBandpass(int stage, float frequency, float q, int8_t channel, int8_t codec) 
-	{
-		int coef[5];
-		frequency = frequency / 2.0;
-		double w0 = frequency * (2.0f * 3.141592654f / AUDIO_SAMPLE_RATE_EXACT); 
-		double sinW0 = sin(w0);
-		double alpha = sinW0 / ((double)q * 2.0);
-		double cosW0 = cos(w0);
-		double scalex = xscalex / (1.0 + alpha);
+		break;
+	case AIC_BANDPASS:
 		/* b0 */ coef[0] = alpha * scalex;
 		/* b1 */ coef[1] = 0;
 		/* b2 */ coef[2] = (-alpha) * scalex;
-		/* a1 */ coef[3] = (-2.0 * cosW0) * scalex;
-		/* a2 */ coef[4] = (1.0 - alpha) * scalex;
-		setDACfilter(stage, coef, channel, codec);
-	}
-	void AudioControlTLV320AIC3104::setNotch(int stage, float frequency, float q, int8_t channel, int8_t codec) 
-	{
-		int coef[5];
-		frequency = frequency / 2.0;
-		double w0 = frequency * (2.0f * 3.141592654f / AUDIO_SAMPLE_RATE_EXACT);
-		double sinW0 = sin(w0);
-		double alpha = sinW0 / ((double)q * 2.0);
-		double cosW0 = cos(w0);
-		double scalex = xscalex / (1.0 + alpha);
+		break;
+	default: // AIC_NOTCH
 		/* b0 */ coef[0] = scalex;
 		/* b1 */ coef[1] = (-2.0 * cosW0) * scalex;
 		/* b2 */ coef[2] = coef[0];
-		/* a1 */ coef[3] = (-2.0 * cosW0) * scalex;
-		/* a2 */ coef[4] = (1.0 - alpha) * scalex;
-		setDACfilter(stage, coef, channel, codec);
-	}
-	void AudioControlTLV320AIC3104::setLowShelf(int stage, float frequency, float gain, float slope, int8_t channel, int8_t codec) 
-	{
-		int coef[5];
-		frequency = frequency / 2.0;
-		double a = pow(10.0, gain/40.0f);
-		double w0 = frequency * (2.0f * 3.141592654f / AUDIO_SAMPLE_RATE_EXACT);
-		double sinW0 = sin(w0);
-		//double alpha = (sinW0 * sqrt((a+1/a)*(1/slope-1)+2) ) / 2.0;
-		double cosW0 = cos(w0);
-		//generate three helper-values (intermediate results):
-		double sinsq = sinW0 * sqrt( (pow(a,2.0)+1.0)*(1.0/(double)slope-1.0)+2.0*a );
-		double aMinus = (a-1.0)*cosW0;
-		double aPlus = (a+1.0)*cosW0;
-		double scalex = xscalex / ( (a+1.0) + aMinus + sinsq);
-		/* b0 */ coef[0] =		a *	( (a+1.0) - aMinus + sinsq	) * scalex;
-		/* b1 */ coef[1] =  2.0*a * ( (a-1.0) - aPlus  			) * scalex;
-		/* b2 */ coef[2] =		a * ( (a+1.0) - aMinus - sinsq 	) * scalex;
-		/* a1 */ coef[3] = -2.0*	( (a-1.0) + aPlus			) * scalex;
-		/* a2 */ coef[4] =  			( (a+1.0) + aMinus - sinsq	) * scalex;
-		setDACfilter(stage, coef, channel, codec);
-	}
-	void AudioControlTLV320AIC3104::setHighShelf(int stage, float frequency, float gain, float slope, int8_t channel, int8_t codec) 
-	{
-		int coef[5];
-		frequency = frequency / 2.0;
-		double a = pow(10.0, gain/40.0f);
-		double w0 = frequency * (2.0f * 3.141592654f / AUDIO_SAMPLE_RATE_EXACT);
-		double sinW0 = sin(w0);
-		//double alpha = (sinW0 * sqrt((a+1/a)*(1/slope-1)+2) ) / 2.0;
-		double cosW0 = cos(w0);
-		//generate three helper-values (intermediate results):
-		double sinsq = sinW0 * sqrt( (pow(a,2.0)+1.0)*(1.0/(double)slope-1.0)+2.0*a );
-		double aMinus = (a-1.0)*cosW0;
-		double aPlus = (a+1.0)*cosW0;
-		double scalex = xscalex / ( (a+1.0) - aMinus + sinsq);
-		/* b0 */ coef[0] =		a *	( (a+1.0) + aMinus + sinsq	) * scalex;
-		/* b1 */ coef[1] = -2.0*a * ( (a-1.0) + aPlus  			) * scalex;
-		/* b2 */ coef[2] =		a * ( (a+1.0) + aMinus - sinsq 	) * scalex;
-		/* a1 */ coef[3] =  2.0*	( (a-1.0) - aPlus			) * scalex;
-		/* a2 */ coef[4] =  			( (a+1.0) - aMinus - sinsq	) * scalex;
-		setDACfilter(stage, coef, channel, codec);
+		break;
 	}
+}
+
+void AudioControlTLV320AIC3104::setHighpass(int stage, float frequency, float q, int8_t channel, int8_t codec) 
+{
+	int coef[5];
+	designFilter(AIC_HIGHPASS, frequency, q, 0, coef);
+	setDACfilter(stage, coef, channel, codec);
+}
+
+void AudioControlTLV320AIC3104::setLowpass(int stage, float frequency, float q, int8_t channel, int8_t codec) 
+{
+	int coef[5];
+	designFilter(AIC_LOWPASS, frequency, q, 0, coef);
+	setDACfilter(stage, coef, channel, codec);
+}
+
+void AudioControlTLV320AIC3104::setBandpass(int stage, float frequency, float q, int8_t channel, int8_t codec) 
+{
+	int coef[5];
+	designFilter(AIC_BANDPASS, frequency, q, 0, coef);
+	setDACfilter(stage, coef, channel, codec);
+}
+
+void AudioControlTLV320AIC3104::setNotch(int stage, float frequency, float q, int8_t channel, int8_t codec) 
+{
+	int coef[5];
+	designFilter(AIC_NOTCH, frequency, q, 0, coef);
+	setDACfilter(stage, coef, channel, codec);
+}
+
+void AudioControlTLV320AIC3104::setLowShelf(int stage, float frequency, float gain, float slope, int8_t channel, int8_t codec) 
+{
+	int coef[5];
+	designFilter(AIC_LOWSHELF, frequency, slope, gain, coef);
+	setDACfilter(stage, coef, channel, codec);
+}
+
+void AudioControlTLV320AIC3104::setHighShelf(int stage, float frequency, float gain, float slope, int8_t channel, int8_t codec) 
+{
+	int coef[5];
+	designFilter(AIC_HIGHSHELF, frequency, slope, gain, coef);
+	setDACfilter(stage, coef, channel, codec);
+}
 
 // Custom biquad filter: which should be scaled to int16 in an int array - see the Teensy calculations above.
 // order is N0, N1, N2, D1, D2 (D0 set in hardware)
@@ -173,6 +171,7 @@ void AudioControlTLV320AIC3104::setTIBQFilter(int stage, const int16_t *coefx, i
 */
 void AudioControlTLV320AIC3104::setDACfilter(int stage, const int *coef, int8_t channel, int8_t codec)
 {
+	TDM_PROFILE_SCOPE("aic setDACfilter", -1);
 	bool setOn = (coef != NULL);
 	int16_t coefx[5] = {0,0,0,0,0};
 	int cst, cend;
@@ -28,6 +28,7 @@ void AudioControlTLV320AIC3104::reset()
 }
 uint8_t AudioControlTLV320AIC3104::begin()
 {
+	TDM_PROFILE_SCOPE("aic begin", -1);
 	// _i2c->setWireTimeout(AIC_I2C_TIMEOUT, true);
 	pinMode(_resetPin, OUTPUT);
 	digitalWrite(_resetPin, HIGH);
@@ -60,12 +61,17 @@ bool AudioControlTLV320AIC3104::writeRegister(uint8_t reg, uint8_t value, uint8_
 	int bytes = 0;
 	//uint8_t buf[2] = { static_cast<uint8_t>(reg & 0xFF), static_cast<uint8_t>(value & 0xFF) };
 //if(reg == 9) fprintf(stderr, "W9[%i] 0x%02x\n", codec,value);
+	_i2cStats.writes++;
+	_i2cStats.bytes += 3;
+	if(_i2cSim)
+		return true;
 	_i2c->beginTransmission(_codec_I2C_address); 
 		bytes = _i2c->write(reg); // separate writes for register number and value
 		bytes += _i2c->write(value); 
   	_i2c->endTransmission(true); 		
 	if(bytes != 2)
 	{
+		_i2cStats.errors++;
 		fprintf(stderr, "Failed to write register %d on I2c codec\n", reg);
 		return false;
 	}
@@ -84,14 +90,22 @@ int AudioControlTLV320AIC3104::readRegister(uint8_t reg, uint8_t codec)
 #ifndef SINGLE_CODEC
 	muxDecode(codec);
 #endif
+	_i2cStats.reads++;
+	_i2cStats.bytes += 4; // address + register, address + data
+	if(_i2cSim)
+		return 0;
 	_i2c->beginTransmission(_codec_I2C_address); 
 		bytes = _i2c->write(reg); 
  	_i2c->endTransmission(false);  // or TLV will enter auto-increment mode and return value of reg+1
 	if(bytes != 1)
+	{
+		_i2cStats.errors++;
 		fprintf(stderr,"failed I2C read setup: reg %d on codec %i\n", reg, codec);
+	}
 	bytes = _i2c->requestFrom(_codec_I2C_address, (uint8_t)1); 
 	if(bytes < 1)
 	{
+		_i2cStats.errors++;
 		fprintf(stderr,"I2C data read fail on codec %i\n", codec);
 		return -1;
 	}	
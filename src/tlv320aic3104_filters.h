@@ -37,6 +37,7 @@ disable: freq < 1
 */
 void AudioControlTLV320AIC3104::adcHPF(int freq, int8_t channel, int8_t codec)
 {
+	TDM_PROFILE_SCOPE("aic adcHPF", -1);
 	int cst, cend;
 	uint8_t r12;
 	freq = constrain(freq, 0, AIC_HPF_UPPER); 
@@ -6,9 +6,15 @@
 bool AudioControlTLV320AIC3104::muxWrite(uint8_t muxAddress, uint8_t value) 
 {
 	uint8_t error;
+	_i2cStats.mux_writes++;
+	_i2cStats.bytes += 2;
+	if(_i2cSim)
+		return true;
   	_i2c->beginTransmission(muxAddress);
   	_i2c->write(value);
   	error = _i2c->endTransmission(true);
+	if(error)
+		_i2cStats.errors++;
 
 	return (error == 0);
 }
@@ -18,6 +24,10 @@ uint8_t AudioControlTLV320AIC3104::muxRead(uint8_t muxAddress)
 { 
 	uint8_t val;
 
+	_i2cStats.reads++;
+	_i2cStats.bytes += 2;
+	if(_i2cSim)
+		return 0;
   	_i2c->requestFrom(muxAddress, (uint8_t)1);
   	val = _i2c->read();
   	return val;
@@ -34,8 +44,15 @@ uint8_t AudioControlTLV320AIC3104::muxProbe()
 	{
 		_mux_I2C_address[_activeMuxes] = 0;
 		addr = TCA9546_BASE_ADDRESS + i;
-		_i2c->beginTransmission(addr); 
-		result = _i2c->endTransmission(true);
+		_i2cStats.probes++;
+		_i2cStats.bytes++;
+		if(_i2cSim)
+			result = (i < _codecs / 4) ? 0 : 2; // simulated boards, NAK from the rest
+		else
+		{
+			_i2c->beginTransmission(addr); 
+			result = _i2c->endTransmission(true);
+		}
 		if(result  == 0)
 		{
 			_mux_I2C_address[_activeMuxes] = TCA9546_BASE_ADDRESS + i;
@@ -61,6 +61,97 @@ unsigned long AudioControlTLV320AIC3104::setPllClkIn(long sampRate)
 	return pll.clk;
 }
 
+// Change the sample rate at run time: 44100, 48000, 88200 or 96000.
+// Before enable() this only sets the rate used by enable() and the TDM drivers.
+// While running, each CODEC is muted and its ADC/DAC powered down, R7 and the PLL are rewritten
+// and the TDM clocks (PLL4, SAI dividers) moved to the new rate, then power and mutes are restored.
+// Only TDM mode reprograms the Teensy clocks: in I2S mode the rate can be changed before enable() only.
+// If the Teensy clocks can't take the rate (Teensy 3), nothing changes and the result is false.
+// Audio objects that are tuned with AUDIO_SAMPLE_RATE_EXACT (oscillators, filters) are not retuned.
+bool AudioControlTLV320AIC3104::setSampleRate(long rate)
+{
+	TDM_PROFILE_SCOPE("aic setSampleRate", -1);
+	uint8_t mutes[AIC_MAX_CODECS][4], power[AIC_MAX_CODECS][3];
+	static const uint8_t muteRegs[4] = {15, 16, 43, 44}; // ADC PGA L/R, DAC volume L/R: bit 7 mutes
+	static const uint8_t powerRegs[3] = {19, 22, 37}; // ADC L/R: bit 2, DAC L/R: bits 7-6
+
+	if (rate != 44100 && rate != 48000 && rate != 88200 && rate != 96000)
+		return false;
+	if (_isRunning && _i2sMode != AICMODE_TDM)
+		return false;
+
+	if (_isRunning)
+	{
+		for (int i = 0; i < _codecs; i++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				mutes[i][r] = readRegister(muteRegs[r], i);
+				writeRegister(muteRegs[r], mutes[i][r] | 0x80, i);
+			}
+		}
+		delay(50); // wait for soft stepping to complete
+		for (int i = 0; i < _codecs; i++)
+		{
+			power[i][0] = readRegister(19, i);
+			power[i][1] = readRegister(22, i);
+			power[i][2] = readRegister(37, i);
+			writeRegister(19, power[i][0] & ~0x04, i);
+			writeRegister(22, power[i][1] & ~0x04, i);
+			writeRegister(37, power[i][2] & ~0xC0, i);
+		}
+	}
+
+	long oldRate = _sampleRate, oldBase = _baseRate;
+	bool oldDual = _dualRate;
+	aic_pll oldPll = pll;
+
+	_sampleRate = rate;
+	_dualRate = (_sampleRate > 48000);
+	_baseRate = (_sampleRate % 8000 == 0) ? 48000 : 44100;
+	// dual rate: FsRef stays at the base rate while BCLK and MCLK double
+	setPllClkIn(_baseRate);
+	if (_dualRate)
+	{
+		pll.clk *= 2;
+		pll.p *= 2;
+	}
+	pll.q = _dualRate ? 4 : 2;
+
+	// the Teensy clocks first: if they can't follow, the CODECs stay at the old rate
+	bool ok = (_i2sMode != AICMODE_TDM) || tdm_set_sample_rate(rate);
+	if (!ok)
+	{
+		_sampleRate = oldRate;
+		_dualRate = oldDual;
+		_baseRate = oldBase;
+		pll = oldPll;
+	}
+
+	if (_isRunning)
+	{
+		if (ok)
+		{
+			for (int i = 0; i < _codecs; i++)
+			{
+				writeR7(i);
+				enablePll(!_usingMCLK, i);
+			}
+		}
+		for (int i = 0; i < _codecs; i++)
+		{
+			for (int r = 0; r < 3; r++)
+				writeRegister(powerRegs[r], power[i][r], i);
+		}
+		for (int i = 0; i < _codecs; i++)
+		{
+			for (int r = 0; r < 4; r++)
+				writeRegister(muteRegs[r], mutes[i][r], i);
+		}
+	}
+	return ok;
+}
+
 // Set pll struct variables, except q, but don't write changes to CODECs.
 int AudioControlTLV320AIC3104::setPll(uint32_t clk, uint32_t p, uint32_t r, uint32_t j,uint32_t d)
 {
@@ -86,17 +177,15 @@ int AudioControlTLV320AIC3104::setPll(uint32_t clk, uint32_t p, uint32_t r, uint
 // Call after setPll()
 void AudioControlTLV320AIC3104::enablePll(bool enabled, int codec)
 {
-	uint8_t r3 = (enabled) ? 0x80 : 0 | pll.q << 3 | pll.p;
+	// R3: enable, Q (16 and 17 wrap to 0 and 1), P (8 wraps to 0)
+	uint8_t r3 = ((enabled) ? 0x80 : 0) | (pll.q & 0x0f) << 3 | (pll.p & 0x07);
 	uint8_t r102 = (enabled)? 0x22: 0x02; // p75 - BCLK for PLLCLK_IN, MCLK for CLKDIV_IN 
-	for(int i = 0; i < _codecs; i++)
-	{
-			writeRegister(4, pll.j << 2, codec);
-			writeRegister(5, (pll.d >> 6) & 0xff , codec);
-			writeRegister(6, (pll.d << 2) & 0xff, codec);
-			writeRegister(11, pll.r & 0x0f, codec);
-			writeRegister(102, r102, codec);	//
-			writeRegister(3, r3, codec); // do this last 
-	}
+	writeRegister(4, pll.j << 2, codec);
+	writeRegister(5, (pll.d >> 6) & 0xff , codec);
+	writeRegister(6, (pll.d << 2) & 0xff, codec);
+	writeRegister(11, pll.r & 0x0f, codec);
+	writeRegister(102, r102, codec);	//
+	writeRegister(3, r3, codec); // do this last 
 }
 
 aic_pll AudioControlTLV320AIC3104::getPll()
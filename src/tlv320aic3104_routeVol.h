@@ -63,6 +63,7 @@ bool AudioControlTLV320AIC3104::inputSelect(int level, int8_t channel, int8_t co
 // compatible with AudioControl.h
 bool AudioControlTLV320AIC3104::inputLevel(float gain, int8_t channel, int8_t codec) 	
 {
+	TDM_PROFILE_SCOPE("aic inputLevel", -1);
 	_gainStep = gainInteger(gainToStep(-gain), channel, codec);
 	return (_gainStep > 0);
 }
@@ -132,6 +133,7 @@ bool AudioControlTLV320AIC3104::DACpower(dacPwr pwr, int8_t codec)
 // vol float 0..1
 bool AudioControlTLV320AIC3104::volume(float vol, int8_t channel, int8_t codec)
 {
+	TDM_PROFILE_SCOPE("aic volume", -1);
 	vol = constrain(vol, 0.0, 1.0);
 	uint8_t volStep = calcStep(vol);
 	uint8_t DACmute = 0;